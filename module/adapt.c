@@ -0,0 +1,151 @@
+#include "adapt.h"
+
+#include <linux/device.h>  /* device (attriutes) */
+#include <linux/cpumask.h> /* for_each_cpu */
+#include <linux/time64.h>  /* NSEC_PER_MSEC */
+
+#include "utilities.h"
+
+#ifdef MAT_ADAPT_PERIOD
+/*
+ * device attribute functions for managing the controller of the sample period
+ */
+static ssize_t dev_attr_adapt_budget_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", gk_mat_adapt_budget);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_adapt_budget_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* share of time cores may spend in PMI handler in 1/10000 (e.g., 200 is 2%), 0 disables controller */
+    unsigned int tmp;
+
+    if(kstrtouint(buf, 0, &tmp) || tmp > 10000)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%u", count, tmp );
+    WRITE_ONCE(gk_mat_adapt_budget, tmp);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(adapt_budget, S_IRUSR | S_IWUSR, dev_attr_adapt_budget_show, dev_attr_adapt_budget_store);
+
+static ssize_t dev_attr_adapt_window_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%llu\n", gk_mat_adapt_window / NSEC_PER_MSEC);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_adapt_window_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* length of window in ms over which overhead is measured */
+    unsigned int tmp;
+
+    if(kstrtouint(buf, 0, &tmp) || tmp == 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%u", count, tmp );
+    WRITE_ONCE(gk_mat_adapt_window, (u64)tmp * NSEC_PER_MSEC);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(adapt_window, S_IRUSR | S_IWUSR, dev_attr_adapt_window_show, dev_attr_adapt_window_store);
+
+static ssize_t dev_attr_adapt_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* state of controller of selected cores (see "cpu") */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    u64 total_changes = 0;
+    int cpu;
+
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        const struct mat_adapt* adapt = per_cpu_ptr(&cpu_mat_adapt, cpu);
+        if(adapt->changes || adapt->overhead)
+        {
+            MAT_WRITE_BUF("CPU %2d: scale=%llu.%03llu overhead=%llu.%02llu%% changes=%lld\n", cpu,
+                adapt->scale >> MAT_ADAPT_SHIFT, ((adapt->scale & (MAT_ADAPT_ONE - 1)) * 1000) >> MAT_ADAPT_SHIFT,
+                adapt->overhead / 100, adapt->overhead % 100, adapt->changes);
+        }
+        total_changes += adapt->changes;
+    }
+    MAT_WRITE_BUF("total_changes: %lld\n", total_changes);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_adapt_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": reset counters of every core */
+    int tmp;
+    int cpu;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_adapt* adapt = per_cpu_ptr(&cpu_mat_adapt, cpu);
+        adapt->changes  = 0;
+        adapt->overhead = 0;
+    }
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(adapt, S_IRUSR | S_IWUSR, dev_attr_adapt_show, dev_attr_adapt_store);
+
+
+
+/*
+ * setup device attributes for managing the controller of the sample period
+ */
+int adapt_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_adapt_budget);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_adapt_budget.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_adapt_budget.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_adapt_window);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_adapt_window.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_adapt_window.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_adapt);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_adapt.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_adapt.attr.name );
+    return 0;
+}
+
+
+
+void adapt_reset(void)
+{
+    /* cores restore requested periods on their next PMI */
+    WRITE_ONCE(gk_mat_adapt_budget, 0);
+    WRITE_ONCE(gk_mat_adapt_window, 10 * NSEC_PER_MSEC);
+}
+#endif /* MAT_ADAPT_PERIOD */
@@ -0,0 +1,11 @@
+#ifndef _MAT_ADAPT_H
+#define _MAT_ADAPT_H
+
+#include <linux/mat.h>
+
+#ifdef MAT_ADAPT_PERIOD
+int adapt_setup_devattr(void);
+void adapt_reset(void);
+#endif /* MAT_ADAPT_PERIOD */
+
+#endif /* _MAT_ADAPT_H */
@@ -1,9 +1,19 @@
 #include "corebuffer.h"
 
-#include <linux/slab.h>    /* vmalloc, vfree */
+#include <linux/slab.h>    /* kvcalloc, kvfree */
+#include <linux/vmalloc.h> /* vzalloc_node, vfree, __get_vm_area, free_vm_area */
+#include <linux/io.h>      /* ioremap_page_range */
+#include <linux/gfp.h>     /* alloc_pages_node */
+#include <linux/topology.h> /* cpu_to_node */
 #include <linux/device.h>  /* device (attriutes) */
 #include <linux/uaccess.h> /* copy_to/from_user() */
+#include <linux/uio.h>     /* iov_iter, copy_to_iter */
 #include <linux/cpumask.h> /* nr_cpu_ids, num_online_cpus */
+#include <linux/mm.h>      /* vm_insert_page, vmalloc_to_page */
+#include <linux/rwsem.h>   /* down/up_read/write */
+#include <linux/poll.h>    /* poll_wait */
+#include <linux/random.h>  /* get_random_u64 */
+#include <linux/rcupdate.h> /* synchronize_rcu, rcu_assign_pointer */
 
 #include "utilities.h"
 
@@ -12,28 +22,202 @@ u64 g_debug_inc = 0;
 #endif
 
 #ifdef MAT_ADDR_BUFFERS
-ssize_t gm_corebuffer_bytes = 0;
+/*
+ * readers of buffers (read, mmap) of any core hold the lock for reading,
+ * so drains of different cores run concurrently. creating and deleting
+ * buffers holds the lock for writing.
+ */
+static DECLARE_RWSEM(gm_corebuffer_rwsem);
+/* allocate new buffers as blocks of huge pages (fall back to 4 KiB pages) */
+static bool gm_buffers_hugepages = false;
+/*
+ * header page of mappings of each core (struct mat_mmap_header), shared by
+ * all mappings of the core and kept until the module is unloaded. allocated
+ * on first mmap of the core, refreshed by mmap, read and poll of the core.
+ */
+static struct page** gm_mmap_headers = NULL;
+
+
+
+/* update header page of core with id @cpu; caller holds lock */
+static void mmap_header_refresh(int cpu)
+{
+    struct page* page = READ_ONCE(gm_mmap_headers[cpu]);
+    struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+    struct mat_mmap_header* header;
+    u64 offset;
+    u32 idx;
+
+    if(!page)
+    {
+        return;
+    }
+    header = (struct mat_mmap_header*) page_address(page);
+    header->format = MAT_MMAP_FORMAT_RAW;
+#ifdef MAT_ADDR_ENCODING
+    if(gk_mat_buffers_encoding == MAT_BUF_ENCODING_VARINT)
+    {
+        header->format = MAT_MMAP_FORMAT_VARINT;
+    }
+#endif /* MAT_ADDR_ENCODING */
+    header->policy = gk_mat_buffers_policy;
+#ifdef MAT_ADDR_RECORDS
+    header->schema = gk_mat_buffers_schema;
+#endif /* MAT_ADDR_RECORDS */
+    offset = PAGE_SIZE;
+    for(idx=0; idx<MAT_BUF_NUM; idx++)
+    {
+        struct mat_buffer* buffer = &(buffers->buffers[idx]);
+        header->buffers[idx].offset   = offset;
+        header->buffers[idx].capacity = buffer->capacity;
+        WRITE_ONCE(header->buffers[idx].size, READ_ONCE(buffer->size));
+        offset += PAGE_ALIGN(buffer->capacity * sizeof(u64));
+    }
+    WRITE_ONCE(header->buf_idx, READ_ONCE(buffers->buf_idx));
+}
+
+
+
+/* buffers of core with id @cpu are freed, its mappings are stale; caller holds lock for writing */
+static void mmap_header_invalidate(int cpu)
+{
+    struct page* page = gm_mmap_headers ? gm_mmap_headers[cpu] : NULL;
+    if(page)
+    {
+        struct mat_mmap_header* header = (struct mat_mmap_header*) page_address(page);
+        WRITE_ONCE(header->generation, header->generation + 1);
+    }
+}
+
+
+
+/* free @num blocks of @buffer; pages mapped to user space are freed when unmapped */
+static void destroy_blocks(struct mat_buffer* buffer, u64 num)
+{
+    u64 i, j;
+
+    if(buffer->area)
+    {
+        free_vm_area(buffer->area);
+        buffer->area = NULL;
+    }
+    for(i=0; buffer->blocks && i<num; i++)
+    {
+        for(j=0; buffer->blocks[i] && j<(1 << BUFFER_BLOCK_ORDER); j++)
+        {
+            put_page(buffer->blocks[i] + j);
+        }
+    }
+    kvfree(buffer->blocks);
+    buffer->blocks = NULL;
+}
+
+
+
+/*
+ * allocate @bytes as blocks of BUFFER_BLOCK_SIZE on @node and map each block
+ * with a single huge page into a virtually contiguous area, like a huge
+ * I/O mapping. returns NULL if @node has no free blocks.
+ */
+static u64* create_blocks(struct mat_buffer* buffer, u64 bytes, int node)
+{
+    const u64 num = DIV_ROUND_UP(bytes, BUFFER_BLOCK_SIZE);
+    unsigned long addr;
+    unsigned int level;
+    u64 i;
+
+    buffer->blocks = kvcalloc(num, sizeof(struct page*), GFP_KERNEL);
+    /* one more block to align start of mapping to a block */
+    buffer->area   = __get_vm_area((num + 1) * BUFFER_BLOCK_SIZE, VM_IOREMAP, VMALLOC_START, VMALLOC_END);
+    if(!buffer->blocks || !buffer->area)
+    {
+        MAT_MERR_FUNC( "failed to allocate %lld blocks", num );
+        goto err;
+    }
+    addr = ALIGN((unsigned long)buffer->area->addr, BUFFER_BLOCK_SIZE);
+    for(i=0; i<num; i++)
+    {
+        struct page* page = alloc_pages_node(node, GFP_KERNEL | __GFP_THISNODE | __GFP_ZERO | __GFP_NOWARN, BUFFER_BLOCK_ORDER);
+        if(!page)
+        {
+            MAT_MERR_FUNC( "no free block on node %d (%lld of %lld)", node, i, num );
+            goto err;
+        }
+        /* pages with a reference each, vm_insert_page (mmap) needs them */
+        split_page(page, BUFFER_BLOCK_ORDER);
+        buffer->blocks[i] = page;
+        if(ioremap_page_range(addr + i*BUFFER_BLOCK_SIZE, addr + (i+1)*BUFFER_BLOCK_SIZE, page_to_phys(page), PAGE_KERNEL))
+        {
+            MAT_MERR_FUNC( "failed to map block %lld", i );
+            goto err;
+        }
+    }
+    /* huge mappings may be disabled (nohugeiomap), report what we got */
+    buffer->node       = node;
+    buffer->page_shift = PAGE_SHIFT;
+    if(lookup_address(addr, &level) && level == PG_LEVEL_2M)
+    {
+        buffer->page_shift = BUFFER_BLOCK_SHIFT;
+    }
+    MAT_MDBG_FUNC( "mapped %lld blocks of node %d at %lx", num, node, addr );
+    return (u64*) addr;
+
+err:
+    destroy_blocks(buffer, num);
+    return NULL;
+}
+
 
 
+/* page at byte offset @off of data of @buffer */
+static struct page* buffer_page(struct mat_buffer* buffer, u64 off)
+{
+    if(buffer->blocks)
+    {
+        return buffer->blocks[off >> BUFFER_BLOCK_SHIFT] + ((off & (BUFFER_BLOCK_SIZE - 1)) >> PAGE_SHIFT);
+    }
+    return vmalloc_to_page((char*)buffer->data + off);
+}
 
-static u64 create_buffer(struct mat_buffer* buffer, u64 capacity)
+
+
+/*
+ * allocate buffer on NUMA node of core with id @cpu. memory is zeroed,
+ * so every page is present before the producer (NMI) stores to it.
+ */
+static u64 create_buffer(struct mat_buffer* buffer, u64 capacity, int cpu)
 {
+    const int node = cpu_to_node(cpu);
+    const u64 bytes = sizeof(u64)*capacity;
+
     if(!buffer)
     {
         MAT_MERR_FUNC( "NULL buffer" );
         return 0;
     }
 
-    buffer->data     = NULL;
-    buffer->size     = 0;
-    buffer->capacity = 0;
-    buffer->data     = (u64*) vmalloc( sizeof(u64)*capacity );
+    buffer->data       = NULL;
+    buffer->size       = 0;
+    buffer->capacity   = 0;
+    buffer->blocks     = NULL;
+    buffer->area       = NULL;
+    if(gm_buffers_hugepages)
+    {
+        buffer->data = create_blocks(buffer, bytes, node);
+    }
     if(!buffer->data)
     {
-        MAT_MERR_FUNC( "failed vmalloc %lld bytes", capacity );
-        return 0;
+        buffer->data = (u64*) vzalloc_node( bytes, node );
+        if(!buffer->data)
+        {
+            MAT_MERR_FUNC( "failed vzalloc_node %lld bytes node %d", bytes, node );
+            return 0;
+        }
+        /* pages come from other nodes if @node is exhausted */
+        buffer->node       = page_to_nid(vmalloc_to_page(buffer->data));
+        buffer->page_shift = PAGE_SHIFT;
     }
-    MAT_MDBG_FUNC( "vmalloc %lld bytes", capacity );
+    MAT_MDBG_FUNC( "allocated %lld bytes cpu %d node %d page_shift %d", bytes, cpu, buffer->node, buffer->page_shift );
     buffer->capacity = capacity;
 
     return capacity;
@@ -45,28 +229,50 @@ static void destoy_buffer(struct mat_buffer* buffer)
 {
     if(buffer && buffer->data)
     {
+        MAT_MDBG_FUNC( "free buffer->data=%px", buffer->data );
+        if(buffer->blocks)
+        {
+            destroy_blocks(buffer, DIV_ROUND_UP(buffer->capacity * sizeof(u64), BUFFER_BLOCK_SIZE));
+        }
+        else
+        {
+            vfree( buffer->data );
+        }
         buffer->capacity = 0;
         buffer->size     = 0;
-        MAT_MDBG_FUNC( "vfree buffer->data=%px", buffer->data );
-        vfree( buffer->data );
         buffer->data     = NULL;
     }
 }
 
 
 
-static u64 create_buffers(struct mat_buffers* buffers, u64 capacity)
+static u64 create_buffers(struct mat_buffers* buffers, u64 capacity, int cpu)
 {
     u32 idx;
     u64 ret;
     struct mat_buffer* buffer;
 
-    buffers->buf_idx = 0;
+    buffers->buf_idx  = 0;
+    buffers->accepted = 0;
+    buffers->dropped  = 0;
+    buffers->zero     = 0;
+    buffers->seen     = 0;
+    buffers->rnd      = get_random_u64() | 1; /* xorshift state must not be 0 */
+#ifdef MAT_ADDR_STREAM
+    buffers->head = 0;
+    buffers->tail = 0;
+#endif /* MAT_ADDR_STREAM */
+#ifdef MAT_ADDR_ENCODING
+    buffers->enc_pos  = 0;
+    buffers->enc_prev = 0;
+    buffers->enc_left = 0;
+    memset(buffers->enc_samples, 0, sizeof(buffers->enc_samples));
+#endif /* MAT_ADDR_ENCODING */
     ret = 0;
     for(idx=0; idx<MAT_BUF_NUM; idx++)
     {
         buffer = &(buffers->buffers[idx]);
-        ret += create_buffer(buffer, capacity);
+        ret += create_buffer(buffer, capacity, cpu);
     }
     return ret;
 }
@@ -79,6 +285,10 @@ static void destoy_buffers(struct mat_buffers* buffers)
     struct mat_buffer* buffer;
 
     buffers->buf_idx = 0;
+#ifdef MAT_ADDR_STREAM
+    buffers->head = 0;
+    buffers->tail = 0;
+#endif /* MAT_ADDR_STREAM */
     for(idx=0; idx<MAT_BUF_NUM; idx++)
     {
         buffer = &(buffers->buffers[idx]);
@@ -88,16 +298,296 @@ static void destoy_buffers(struct mat_buffers* buffers)
 
 
 
+/*
+ * index of the @i-th oldest buffer of a core. with the overwrite
+ * policy, the buffer after the active buffer holds the oldest samples.
+ * otherwise, buffers are filled in order of their index.
+ */
+static u32 buffers_order(struct mat_buffers* buffers, u32 i)
+{
+    if(gk_mat_buffers_policy == MAT_BUF_POLICY_OVERWRITE)
+    {
+        return (buffers->buf_idx + 1 + i) & MAT_BUF_IDX_MASK;
+    }
+    return i;
+}
+
+
+
 static void destoy_allbuffers(void)
 {
-    const int CPUS = num_online_cpus();
     int cpu;
-    for(cpu=0; cpu<CPUS; cpu++)
+    for_each_possible_cpu(cpu)
     {
         struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
         destoy_buffers( buffers );
+        mmap_header_invalidate(cpu);
+    }
+}
+
+
+
+#ifdef MAT_ADDR_POOL
+/* pool is replaced with the lock held for writing, readers hold it for reading */
+static struct mat_pool* pool_get(void)
+{
+    return rcu_dereference_protected(gk_mat_pool, lockdep_is_held(&gm_corebuffer_rwsem));
+}
+
+
+
+/* return all chunks to @pool, cores start new chains; producer must not run */
+static void pool_clear(struct mat_pool* pool)
+{
+    int cpu;
+    if(pool)
+    {
+        atomic_set(&(pool->used), 0);
+    }
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        buffers->pool_first = MAT_POOL_NONE;
+        buffers->pool_last  = MAT_POOL_NONE;
+        buffers->buf_idx    = 0;
+        buffers->accepted   = 0;
+        buffers->dropped    = 0;
+        buffers->zero       = 0;
+        /* no active chunk, first sample takes one */
+        memset(buffers->buffers, 0, sizeof(buffers->buffers));
+    }
+}
+
+
+
+/* free @pool, which is not published (anymore) */
+static void pool_free(struct mat_pool* pool)
+{
+    u32 i;
+
+    for(i=0; pool->chunks && i<pool->num; i++)
+    {
+        if(pool->chunks[i])
+        {
+            free_pages((unsigned long)pool->chunks[i], BUFFER_BLOCK_ORDER);
+        }
+    }
+    MAT_MDBG_FUNC( "freed %d chunks", pool->num );
+    kvfree(pool->chunks);
+    kvfree(pool->sizes);
+    kvfree(pool->next);
+    kfree(pool);
+}
+
+
+
+static void pool_destroy(void)
+{
+    struct mat_pool* pool = pool_get();
+
+    /* without pool, per-core buffers are not chunks */
+    if(!pool)
+    {
+        return;
+    }
+    gk_mat_buffers_pool = 0;
+    rcu_assign_pointer(gk_mat_pool, NULL);
+    /* producers (NMIs) may still take chunks of @pool */
+    synchronize_rcu();
+    pool_clear(NULL);
+    pool_free(pool);
+}
+
+
+
+/*
+ * create pool of @bytes (rounded up to chunks of BUFFER_BLOCK_SIZE) and
+ * switch to pool mode. chunks are physically contiguous, the kernel
+ * accesses them through its direct mapping (huge pages).
+ * per-core buffers must be deleted before.
+ */
+static int pool_create(u64 bytes)
+{
+    struct mat_pool* pool;
+    u32 i;
+
+    pool = kzalloc(sizeof(struct mat_pool), GFP_KERNEL);
+    if(!pool)
+    {
+        return -ENOMEM;
+    }
+    pool->num      = DIV_ROUND_UP(bytes, BUFFER_BLOCK_SIZE);
+    pool->capacity = BUFFER_BLOCK_SIZE / sizeof(u64);
+    pool->chunks   = kvcalloc(pool->num, sizeof(u64*), GFP_KERNEL);
+    pool->sizes    = kvcalloc(pool->num, sizeof(u64), GFP_KERNEL);
+    pool->next     = kvcalloc(pool->num, sizeof(u32), GFP_KERNEL);
+    atomic_set(&(pool->used), 0);
+    if(!pool->chunks || !pool->sizes || !pool->next)
+    {
+        MAT_MERR_FUNC( "failed kvcalloc %d chunks", pool->num );
+        pool_free(pool);
+        return -ENOMEM;
+    }
+    for(i=0; i<pool->num; i++)
+    {
+        pool->chunks[i] = (u64*) __get_free_pages(GFP_KERNEL | __GFP_NOWARN, BUFFER_BLOCK_ORDER);
+        if(!pool->chunks[i])
+        {
+            MAT_MERR_FUNC( "failed to allocate chunk %d of %d", i, pool->num );
+            pool_free(pool);
+            return -ENOMEM;
+        }
+    }
+    MAT_MDBG_FUNC( "allocated %d chunks of %ld bytes", pool->num, BUFFER_BLOCK_SIZE );
+    /* publish pool once it is complete */
+    pool_clear(pool);
+    rcu_assign_pointer(gk_mat_pool, pool);
+    gk_mat_buffers_pool = 1;
+    return 0;
+}
+
+
+
+/* number of elements in chain of chunks of a core */
+static u64 pool_chain_size(struct mat_buffers* buffers)
+{
+    const struct mat_pool* pool = pool_get();
+    u64 size = 0;
+    u32 chunk;
+
+    for(chunk=buffers->pool_first; pool && chunk != MAT_POOL_NONE; chunk=pool->next[chunk])
+    {
+        if(chunk == buffers->pool_last)
+        {
+            size += buffers->buffers[0].size;
+            break;
+        }
+        size += pool->sizes[chunk];
+    }
+    return size;
+}
+
+
+
+/* read chain of chunks of a core, offset @off refers to data of all chunks in order */
+static ssize_t pool_read(struct mat_buffers* buffers, struct iov_iter *to, loff_t *off)
+{
+    const struct mat_pool* pool = pool_get();
+    const size_t len = iov_iter_count(to);
+    u64 skip = *off;
+    size_t bytes = 0;
+    u32 chunk;
+
+    for(chunk=buffers->pool_first; pool && chunk != MAT_POOL_NONE && bytes < len; chunk=pool->next[chunk])
+    {
+        const bool last = (chunk == buffers->pool_last);
+        const u64 chunk_bytes = (last ? buffers->buffers[0].size : pool->sizes[chunk]) * sizeof(u64);
+        size_t copy_bytes;
+
+        if(skip < chunk_bytes)
+        {
+            copy_bytes = min_t(u64, chunk_bytes - skip, len - bytes);
+            /* chunks are not split into pages of their own, always copy */
+            if(copy_to_iter((char*)pool->chunks[chunk] + skip, copy_bytes, to) != copy_bytes)
+            {
+                MAT_MERR_FUNC( "len=%ld off=%lld chunk=%d", len, *off, chunk );
+                return -EFAULT;
+            }
+            bytes += copy_bytes;
+            skip   = 0;
+        }
+        else
+        {
+            skip -= chunk_bytes;
+        }
+        if(last)
+        {
+            break;
+        }
+    }
+    *off += bytes;
+    MAT_MDBG_FUNC( "len=%ld off=%lld bytes=%ld", len, *off, bytes );
+    return bytes;
+}
+#endif /* MAT_ADDR_POOL */
+
+
+
+/* empty buffers of every core, e.g., if format of content changes; producer must not run */
+static void buffers_clear(void)
+{
+    int cpu;
+#ifdef MAT_ADDR_POOL
+    if(gk_mat_buffers_pool)
+    {
+        pool_clear(pool_get());
+        return;
+    }
+#endif /* MAT_ADDR_POOL */
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        u32 idx;
+        buffers->buf_idx = 0;
+        buffers->seen    = 0;
+        for(idx=0; idx<MAT_BUF_NUM; idx++)
+        {
+            buffers->buffers[idx].size = 0;
+        }
+    }
+}
+
+
+
+#ifdef MAT_ADDR_STREAM
+/* cores with an active reader in streaming mode (only a single consumer per ring) */
+static struct cpumask gm_stream_readers;
+/* number of elements that have to be available before readers are woken up */
+static u64 gm_stream_watermark = 1;
+
+/* true as long as producer inserts into rings */
+static bool stream_active(void)
+{
+    return gk_mat_buffers_enabled && gk_mat_buffers_stream;
+}
+
+/* number of elements in ring not read yet; only called by consumer */
+static u64 stream_available(struct mat_buffers* buffers)
+{
+    /* pairs with smp_store_release in producer: elements are written */
+    return smp_load_acquire(&(buffers->head)) - buffers->tail;
+}
+
+/* empty rings of every core; producer must not run */
+static void stream_reset(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        u32 idx;
+        buffers->buf_idx   = 0;
+        buffers->head      = 0;
+        buffers->tail      = 0;
+        buffers->watermark = gm_stream_watermark;
+        for(idx=0; idx<MAT_BUF_NUM; idx++)
+        {
+            buffers->buffers[idx].size = 0;
+        }
+    }
+}
+
+/* wake up readers of every core, e.g., if streaming stops */
+static void stream_wakeup_all(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        wake_up_interruptible_all(&(buffers->wait));
     }
 }
+#endif /* MAT_ADDR_STREAM */
 
 
 
@@ -135,7 +625,17 @@ static ssize_t dev_attr_buffers_enabled_store(struct device *dev, struct device_
     {
         return -EINVAL;
     }
-    gk_mat_buffers_enabled = arg;
+    /* not while buffers (or pool) are replaced */
+    down_write(&gm_corebuffer_rwsem);
+    WRITE_ONCE(gk_mat_buffers_enabled, arg);
+    up_write(&gm_corebuffer_rwsem);
+#ifdef MAT_ADDR_STREAM
+    /* readers return remaining elements, then end of file */
+    if(!gk_mat_buffers_enabled)
+    {
+        stream_wakeup_all();
+    }
+#endif /* MAT_ADDR_STREAM */
     MAT_MDBG_FUNC( "count=%ld arg=%d tmp=%ld gk_mat_buffers_enabled=%d", count, arg, tmp, gk_mat_buffers_enabled );
     return count;
 }
@@ -146,26 +646,31 @@ static ssize_t dev_attr_buffers_show(struct device *dev, struct device_attribute
 {
     /*
      * use @cpu to control output.
-     * @gm_cpu >= 0 && @gm_cpu < CPUS: give detailed info about buffers one core
-     * @gm_cpu < 0: show brief summary of all cores
+     * @gm_cpu >= 0: give detailed info about buffers one core
+     * @gm_cpu < 0: show brief summary of selected cores (all traced cores by default)
      */
     const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
     bool  buf_full = false;            /* used by MAT_WRITE_BUF */
-    const int CPUS = num_online_cpus();
     u64 total_capacity;
     u64 total_size;
+    u64 total_dropped;
     MAT_MDBG_FUNC();
 
     total_capacity = 0;
     total_size = 0;
+    total_dropped = 0;
     if(gm_cpu < 0)
     {
         int cpu, idx;
         struct mat_buffers* buffers;
         u64 cpu_capacity;
         u64 cpu_size;
-        for(cpu=0; cpu<CPUS; cpu++)
+        for_each_cpu(cpu, &gm_cpumask)
         {
+            if(!cpumask_test_cpu(cpu, &gm_cpus_selected))
+            {
+                continue;
+            }
             buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
             if( buffers )
             {
@@ -179,16 +684,21 @@ static ssize_t dev_attr_buffers_show(struct device *dev, struct device_attribute
                 }
                 if( cpu_size && cpu_size == cpu_capacity )
                 {
-                    MAT_WRITE_BUF("CPU %2d: %2d# capacity=%lld (%lld MiB) size=%lld (%lld MiB) (full)\n",
-                        cpu, MAT_BUF_NUM, cpu_capacity, (cpu_capacity*8)/(1024*1024), cpu_size, (cpu_size*8)/(1024*1024));
+                    MAT_WRITE_BUF("CPU %2d: %2d# node=%d page=%ld KiB capacity=%lld (%lld MiB) size=%lld (%lld MiB) accepted=%lld dropped=%lld zero=%lld (full)\n",
+                        cpu, MAT_BUF_NUM, buffers->buffers[0].node, (1l << buffers->buffers[0].page_shift)/1024,
+                        cpu_capacity, (cpu_capacity*8)/(1024*1024), cpu_size, (cpu_size*8)/(1024*1024),
+                        buffers->accepted, buffers->dropped, buffers->zero);
                 }
                 else
                 {
-                    MAT_WRITE_BUF("CPU %2d: %2d# capacity=%lld (%lld MiB) size=%lld (%lld MiB)\n",
-                        cpu, MAT_BUF_NUM, cpu_capacity, (cpu_capacity*8)/(1024*1024), cpu_size, (cpu_size*8)/(1024*1024));
+                    MAT_WRITE_BUF("CPU %2d: %2d# node=%d page=%ld KiB capacity=%lld (%lld MiB) size=%lld (%lld MiB) accepted=%lld dropped=%lld zero=%lld\n",
+                        cpu, MAT_BUF_NUM, buffers->buffers[0].node, (1l << buffers->buffers[0].page_shift)/1024,
+                        cpu_capacity, (cpu_capacity*8)/(1024*1024), cpu_size, (cpu_size*8)/(1024*1024),
+                        buffers->accepted, buffers->dropped, buffers->zero);
                 }
                 total_capacity += cpu_capacity;
                 total_size += cpu_size;
+                total_dropped += buffers->dropped;
             }
             else
             {
@@ -196,7 +706,7 @@ static ssize_t dev_attr_buffers_show(struct device *dev, struct device_attribute
             }
         }
     }
-    else if(gm_cpu >= 0 && gm_cpu < CPUS)
+    else
     {
         int cpu, idx;
         struct mat_buffers* buffers;
@@ -216,13 +726,15 @@ static ssize_t dev_attr_buffers_show(struct device *dev, struct device_attribute
                 {
                     if(buffer->capacity && buffer->capacity == buffer->size)
                     {
-                        MAT_WRITE_BUF("CPU %2d %1cBUF %2d: data=%px capacity=%lld (%lld MiB) size=%lld (%lld MiB) (full)\n",
-                            cpu, mark, idx, buffer->data, buffer->capacity, (buffer->capacity*8)/(1024*1024), buffer->size, (buffer->size*8)/(1024*1024));
+                        MAT_WRITE_BUF("CPU %2d %1cBUF %2d: data=%px node=%d page=%ld KiB capacity=%lld (%lld MiB) size=%lld (%lld MiB) (full)\n",
+                            cpu, mark, idx, buffer->data, buffer->node, (1l << buffer->page_shift)/1024,
+                            buffer->capacity, (buffer->capacity*8)/(1024*1024), buffer->size, (buffer->size*8)/(1024*1024));
                     }
                     else
                     {
-                        MAT_WRITE_BUF("CPU %2d %1cBUF %2d: data=%px capacity=%lld (%lld MiB) size=%lld (%lld MiB)\n",
-                            cpu, mark, idx, buffer->data, buffer->capacity, (buffer->capacity*8)/(1024*1024), buffer->size, (buffer->size*8)/(1024*1024));
+                        MAT_WRITE_BUF("CPU %2d %1cBUF %2d: data=%px node=%d page=%ld KiB capacity=%lld (%lld MiB) size=%lld (%lld MiB)\n",
+                            cpu, mark, idx, buffer->data, buffer->node, (1l << buffer->page_shift)/1024,
+                            buffer->capacity, (buffer->capacity*8)/(1024*1024), buffer->size, (buffer->size*8)/(1024*1024));
                     }
                     total_capacity += buffer->capacity;
                     total_size += buffer->size;
@@ -232,6 +744,9 @@ static ssize_t dev_attr_buffers_show(struct device *dev, struct device_attribute
                     MAT_WRITE_BUF("CPU %2d %1cBUF %2d: %px\n", cpu, mark, idx, buffers);
                 }
             }
+            MAT_WRITE_BUF("CPU %2d: accepted=%lld dropped=%lld zero=%lld\n",
+                cpu, buffers->accepted, buffers->dropped, buffers->zero);
+            total_dropped += buffers->dropped;
         }
         else
         {
@@ -255,119 +770,125 @@ static ssize_t dev_attr_buffers_show(struct device *dev, struct device_attribute
     {
         MAT_WRITE_BUF("total_size:     %16lld (%10lld MiB)\n", total_size, total_size);
     }
+    MAT_WRITE_BUF("total_dropped:  %16lld\n", total_dropped);
 
     MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
     return (buf - buf_begin);
 }
-static ssize_t dev_attr_buffers_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+static ssize_t buffers_store(const char *buf, size_t count)
 {
     /*
      * We allow 3 different input types:
-     * "0":   delete all buffers on every core
-     * "N":   allocate all buffers with capacity of N elements on every core
-     * "X N": allocate all buffers with capacity of N elements on core X
+     * "0":      delete all buffers on every core
+     * "N":      allocate all buffers with capacity of N elements on every traced core (cpus)
+     * "LIST N": allocate all buffers with capacity of N elements on cores of cpulist LIST,
+     *           e.g., "3 N" or "0-15,32-47 N" (N = 0 deletes them)
      */
-    const int CPUS = num_online_cpus();
-    s64 arg1, arg2;
-    ssize_t bytes;
+    struct cpumask mask;
     struct mat_buffers* buffers;
+    char* args;
+    char* list;
+    char* arg;
+    bool all_cores;
+    u64 buffer_capacity;
+    u64 total_bytes;
+    ssize_t rval;
+    int cpu;
 
     MAT_MDBG_FUNC();
 
-    arg1 = -1;
-    arg2 = -1;
-    bytes = sscanf(buf, "%lld%lld", &arg1, &arg2);
-    MAT_MDBG_FUNC( "count=%ld arg1=%lld arg2=%lld bytes=%ld per core", count, arg1, arg2, bytes );
-
-
-
-    /* delete all buffers */
-    if(arg1 == 0)
+    args = kstrndup(buf, count, GFP_KERNEL);
+    if(!args)
     {
-        int cpu;
-        MAT_MDBG_FUNC( "destoy_buffers for every core" );
-        for(cpu=0; cpu<CPUS; cpu++)
+        return -ENOMEM;
+    }
+    list = strim(args);
+    arg  = strrchr(list, ' ');
+    all_cores = !arg;
+    if(arg)
+    {
+        *arg++ = '\0';
+        rval = cpulist_parse(list, &mask);
+        if(rval || !cpumask_subset(&mask, cpu_possible_mask))
         {
-            buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
-            destoy_buffers( buffers );
+            MAT_MERR_FUNC( "invalid cpulist %s", list );
+            kfree(args);
+            return -EINVAL;
         }
-        return count;
     }
+    else
+    {
+        arg = list;
+        cpumask_copy(&mask, &gm_cpumask);
+    }
+    rval = kstrtoull(arg, 0, &buffer_capacity);
+    kfree(args);
+    if(rval)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld capacity=%lld cpus=%*pbl", count, buffer_capacity, cpumask_pr_args(&mask) );
 
-
-
-    /* allocate all buffers on every core */
-    if(arg1 > 0 && arg2 == -1 && arg1 * CPUS * MAT_BUF_NUM * 8 <= BUFFER_LIMIT) // limit total buffer size
+    /* "N" and "0" replace buffers of every core, "LIST N" only of listed cores */
+    MAT_MDBG_FUNC( "destoy_buffers" );
+    for_each_cpu(cpu, all_cores ? cpu_possible_mask : &mask)
     {
-        const u64 buffer_capacity = arg1;
-        int cpu;
-        MAT_MDBG_FUNC( "destoy_buffer for every core" );
-        for(cpu=0; cpu<CPUS; cpu++)
-        {
-            buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
-            destoy_buffers( buffers );
-        }
+        buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        destoy_buffers( buffers );
+        mmap_header_invalidate(cpu);
+    }
+    if(buffer_capacity == 0)
+    {
+        return count;
+    }
 
-        MAT_MDBG_FUNC( "create_buffer for every core" );
-        for(cpu=0; cpu<CPUS; cpu++)
+    /* limit total buffer size */
+    total_bytes = buffer_capacity * sizeof(u64) * MAT_BUF_NUM * cpumask_weight(&mask);
+    for_each_possible_cpu(cpu)
+    {
+        u32 idx;
+        buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        for(idx=0; idx<MAT_BUF_NUM; idx++)
         {
-            buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
-            if( !create_buffers(buffers, buffer_capacity) )
-            {
-                MAT_MERR_FUNC( "failed alloc_buffer(%px, %lld)", buffers, buffer_capacity );
-                return -EINVAL;
-            }
+            total_bytes += buffers->buffers[idx].capacity * sizeof(u64);
         }
-
-        return count;
     }
-
-
-
-    /* allocate all buffers on single core */
-    if(arg1 > 0 && arg1 < CPUS && arg2 > 0)
+    MAT_MDBG_FUNC( "total_bytes=%llu", total_bytes );
+    if(buffer_capacity > BUFFER_LIMIT || total_bytes > BUFFER_LIMIT)
     {
-        const int cpu = arg1;
-        const u64 buffer_capacity = arg2;
-        u64 total_bytes = 0;
+        MAT_MERR_FUNC( "total buffer too large" );
+        return -EINVAL;
+    }
 
-        MAT_MDBG_FUNC( "destoy_buffer on core %d", cpu );
+    MAT_MDBG_FUNC( "create_buffers" );
+    for_each_cpu(cpu, &mask)
+    {
         buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
-        destoy_buffers( buffers );
-
-        /* check total total size */
-        {
-            int i;
-            for(i=0; i<CPUS; i++)
-            {
-                u32 idx;
-                buffers = per_cpu_ptr(&cpu_mat_buffers, i);
-                for(idx=0; idx<MAT_BUF_NUM; idx++)
-                {
-                    struct mat_buffer* buffer = &(buffers->buffers[idx]);
-                    total_bytes += buffer->capacity * sizeof(u64);
-                }
-            }
-            MAT_MDBG_FUNC( "total_bytes=%llu", total_bytes );
-        }
-        if( total_bytes + (buffer_capacity * sizeof(u64) * MAT_BUF_NUM) > BUFFER_LIMIT) // limit total buffer size
-        {
-            MAT_MERR_FUNC( "total buffer too large" );
-            return -EINVAL;
-        }
-
-        MAT_MDBG_FUNC( "create_buffers on core %d", cpu );
-        buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
-        if( !create_buffers(buffers, buffer_capacity) )
+        if( !create_buffers(buffers, buffer_capacity, cpu) )
         {
-            MAT_MERR_FUNC( "failed create_buffers(%px, %lld)", buffers, buffer_capacity );
+            MAT_MERR_FUNC( "failed create_buffers(%px, %lld) on core %d", buffers, buffer_capacity, cpu );
             return -EINVAL;
         }
-
-        return count;
     }
+    return count;
+}
+static ssize_t dev_attr_buffers_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    ssize_t rval;
 
-    return -EINVAL;
+#ifdef MAT_ADDR_POOL
+    /* per-core buffers of pool mode are chunks of pool */
+    if(gk_mat_buffers_pool)
+    {
+        MAT_MERR_FUNC( "delete pool (buffers_pool) before allocating buffers" );
+        return -EBUSY;
+    }
+#endif /* MAT_ADDR_POOL */
+    /* wait for readers of buffers to finish */
+    down_write(&gm_corebuffer_rwsem);
+    rval = buffers_store(buf, count);
+    up_write(&gm_corebuffer_rwsem);
+    return rval;
 }
 /* create device attribute dev_attr_<name> */
 static DEVICE_ATTR(buffers, S_IRUSR | S_IWUSR, dev_attr_buffers_show, dev_attr_buffers_store);
@@ -376,42 +897,637 @@ static ssize_t dev_attr_buffers_bytes_show(struct device *dev, struct device_att
 {
     const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
     bool  buf_full = false;            /* used by MAT_WRITE_BUF */
-    const int CPUS = num_online_cpus();
+    ssize_t corebuffer_bytes = 0;
     MAT_MDBG_FUNC();
 
-    if(gm_cpu >= 0 && gm_cpu < CPUS)
+    if(gm_cpu >= 0)
     {
         u32 idx;
         struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, gm_cpu);
-        gm_corebuffer_bytes = 0;
+#ifdef MAT_ADDR_POOL
+        if(gk_mat_buffers_pool)
+        {
+            /* chain of chunks must not be freed meanwhile */
+            down_read(&gm_corebuffer_rwsem);
+            corebuffer_bytes = pool_chain_size(buffers) * sizeof(u64);
+            up_read(&gm_corebuffer_rwsem);
+        }
+        else
+#endif /* MAT_ADDR_POOL */
         for(idx=0; idx<MAT_BUF_NUM; idx++)
         {
             struct mat_buffer *buffer = &(buffers->buffers[idx]);
             if( buffer )
             {
-                gm_corebuffer_bytes += buffer->size * sizeof(u64);
+                corebuffer_bytes += buffer->size * sizeof(u64);
             }
         }
     }
+
+    MAT_WRITE_BUF( "%ld\n", corebuffer_bytes);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_bytes_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return -EROFS;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_bytes, S_IRUSR | S_IWUSR, dev_attr_buffers_bytes_show, dev_attr_buffers_bytes_store);
+
+static ssize_t dev_attr_buffers_hugepages_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gm_buffers_hugepages);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_hugepages_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* applies to buffers allocated afterwards, "buffers" reports the page size obtained */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    gm_buffers_hugepages = tmp;
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_hugepages, S_IRUSR | S_IWUSR, dev_attr_buffers_hugepages_show, dev_attr_buffers_hugepages_store);
+
+#ifdef MAT_ADDR_POOL
+static ssize_t dev_attr_buffers_pool_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* chunks of pool, chunks taken and chunks taken per core */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    const struct mat_pool* pool;
+    int cpu;
+
+    down_read(&gm_corebuffer_rwsem);
+    pool = pool_get();
+    if(!pool)
+    {
+        MAT_WRITE_BUF( "0\n");
+        goto exit;
+    }
+    MAT_WRITE_BUF("chunks=%d (%lld MiB) used=%d chunk=%ld KiB\n", pool->num, ((u64)pool->num*BUFFER_BLOCK_SIZE)/(1024*1024),
+        min_t(u32, atomic_read(&(pool->used)), pool->num), BUFFER_BLOCK_SIZE/1024);
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        u32 chunks = 0;
+        u32 chunk;
+        for(chunk=buffers->pool_first; chunk != MAT_POOL_NONE; chunk=pool->next[chunk])
+        {
+            chunks++;
+            if(chunk == buffers->pool_last)
+            {
+                break;
+            }
+        }
+        MAT_WRITE_BUF("CPU %2d: chunks=%d size=%lld\n", cpu, chunks, pool_chain_size(buffers));
+    }
+exit:
+    up_read(&gm_corebuffer_rwsem);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_pool_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * "0": delete pool, back to per-core buffers of fixed capacity
+     * "N": delete per-core buffers, allocate pool of N bytes shared by all cores
+     */
+    s64 arg;
+    int rval;
+
+    arg = -1;
+    sscanf(buf, "%lld", &arg);
+    if(arg < 0 || arg > BUFFER_LIMIT)
+    {
+        return -EINVAL;
+    }
+    if(arg && (gk_mat_buffers_policy != MAT_BUF_POLICY_STOP
+#ifdef MAT_ADDR_STREAM
+        || gk_mat_buffers_stream
+#endif /* MAT_ADDR_STREAM */
+#ifdef MAT_ADDR_ENCODING
+        || gk_mat_buffers_encoding != MAT_BUF_ENCODING_RAW
+#endif /* MAT_ADDR_ENCODING */
+        ))
+    {
+        MAT_MERR_FUNC( "pool needs policy stop, raw encoding and no stream" );
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld arg=%lld", count, arg );
+
+    down_write(&gm_corebuffer_rwsem);
+    /* producer must not take chunks while pool is replaced */
+    if(gk_mat_buffers_enabled)
+    {
+        up_write(&gm_corebuffer_rwsem);
+        MAT_MERR_FUNC( "disable buffers before changing pool" );
+        return -EBUSY;
+    }
+    pool_destroy();
+    rval = 0;
+    if(arg)
+    {
+        /* producers (NMIs) may still insert into per-core buffers */
+        synchronize_rcu();
+        destoy_allbuffers();
+        rval = pool_create(arg);
+    }
+    up_write(&gm_corebuffer_rwsem);
+    return rval < 0 ? rval : count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_pool, S_IRUSR | S_IWUSR, dev_attr_buffers_pool_show, dev_attr_buffers_pool_store);
+#endif /* MAT_ADDR_POOL */
+
+static const char* const gm_policy_names[MAT_BUF_POLICY_NUM] = {
+    [MAT_BUF_POLICY_STOP]      = "stop",
+    [MAT_BUF_POLICY_OVERWRITE] = "overwrite",
+    [MAT_BUF_POLICY_RESERVOIR] = "reservoir",
+};
+static ssize_t dev_attr_buffers_policy_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* list all policies, mark selected one with brackets */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    int policy;
+    for(policy=0; policy<MAT_BUF_POLICY_NUM; policy++)
+    {
+        if(policy == gk_mat_buffers_policy)
+        {
+            MAT_WRITE_BUF( "[%s] ", gm_policy_names[policy]);
+        }
+        else
+        {
+            MAT_WRITE_BUF( "%s ", gm_policy_names[policy]);
+        }
+    }
+    MAT_WRITE_BUF( "\n");
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_policy_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* accept name or number of policy */
+    int policy;
+    int cpu;
+
+    for(policy=0; policy<MAT_BUF_POLICY_NUM; policy++)
+    {
+        if(sysfs_streq(buf, gm_policy_names[policy]))
+        {
+            break;
+        }
+    }
+    if(policy == MAT_BUF_POLICY_NUM && (sscanf(buf, "%d", &policy) != 1 || policy < 0 || policy >= MAT_BUF_POLICY_NUM))
+    {
+        return -EINVAL;
+    }
+#ifdef MAT_ADDR_ENCODING
+    /* encoded addresses have variable size, they cannot be replaced at random */
+    if(policy == MAT_BUF_POLICY_RESERVOIR && gk_mat_buffers_encoding != MAT_BUF_ENCODING_RAW)
+    {
+        MAT_MERR_FUNC( "reservoir needs raw encoding" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_ENCODING */
+#ifdef MAT_ADDR_RECORDS
+    /* reservoir replaces single addresses */
+    if(policy == MAT_BUF_POLICY_RESERVOIR && gk_mat_buffers_schema)
+    {
+        MAT_MERR_FUNC( "reservoir needs empty record schema" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_RECORDS */
+#ifdef MAT_ADDR_POOL
+    /* chunks of an exhausted pool are not taken back */
+    if(policy != MAT_BUF_POLICY_STOP && gk_mat_buffers_pool)
+    {
+        MAT_MERR_FUNC( "pool needs policy stop" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_POOL */
+    MAT_MDBG_FUNC( "count=%ld policy=%d", count, policy );
+
+    down_write(&gm_corebuffer_rwsem);
+    /* switch policy only while producer does not insert */
+    if(gk_mat_buffers_enabled)
+    {
+        up_write(&gm_corebuffer_rwsem);
+        MAT_MERR_FUNC( "disable buffers before switching policy" );
+        return -EBUSY;
+    }
+    /* PMIs that saw buffers enabled may still insert */
+    synchronize_rcu();
+    gk_mat_buffers_policy = policy;
+    /* samples in buffers count as already seen by reservoir sampling */
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        u32 idx;
+        buffers->seen = 0;
+        for(idx=0; idx<MAT_BUF_NUM; idx++)
+        {
+            buffers->seen += buffers->buffers[idx].size;
+        }
+    }
+    up_write(&gm_corebuffer_rwsem);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_policy, S_IRUSR | S_IWUSR, dev_attr_buffers_policy_show, dev_attr_buffers_policy_store);
+
+#ifdef MAT_ADDR_STREAM
+static ssize_t dev_attr_buffers_stream_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_buffers_stream);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_stream_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+#ifdef MAT_ADDR_ENCODING
+    /* ring counts elements of fixed size */
+    if(tmp && gk_mat_buffers_encoding != MAT_BUF_ENCODING_RAW)
+    {
+        MAT_MERR_FUNC( "stream needs raw encoding" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_ENCODING */
+#ifdef MAT_ADDR_POOL
+    if(gk_mat_buffers_pool)
+    {
+        if(tmp)
+        {
+            MAT_MERR_FUNC( "pool does not support stream" );
+            return -EINVAL;
+        }
+        /* stream is off already */
+        return count;
+    }
+#endif /* MAT_ADDR_POOL */
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+
+    /* content of buffers is dropped when switching mode */
+    down_write(&gm_corebuffer_rwsem);
+    /* switch mode only while producer does not insert */
+    if(gk_mat_buffers_enabled)
+    {
+        up_write(&gm_corebuffer_rwsem);
+        MAT_MERR_FUNC( "disable buffers before switching mode" );
+        return -EBUSY;
+    }
+    /* PMIs that saw buffers enabled may still insert */
+    synchronize_rcu();
+    stream_reset();
+    gk_mat_buffers_stream = tmp;
+    up_write(&gm_corebuffer_rwsem);
+    stream_wakeup_all();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_stream, S_IRUSR | S_IWUSR, dev_attr_buffers_stream_show, dev_attr_buffers_stream_store);
+
+static ssize_t dev_attr_buffers_watermark_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%lld\n", gm_stream_watermark);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_watermark_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* watermark in #elements, at least 1 */
+    s64 arg;
+    int cpu;
+
+    arg = -1;
+    sscanf(buf, "%lld", &arg);
+    if(arg < 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld arg=%lld", count, arg );
+    gm_stream_watermark = arg;
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        WRITE_ONCE(buffers->watermark, gm_stream_watermark);
+    }
+    /* readers may already have enough elements */
+    stream_wakeup_all();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_watermark, S_IRUSR | S_IWUSR, dev_attr_buffers_watermark_show, dev_attr_buffers_watermark_store);
+#endif /* MAT_ADDR_STREAM */
+
+#ifdef MAT_ADDR_ENCODING
+static const char* const gm_encoding_names[MAT_BUF_ENCODING_NUM] = {
+    [MAT_BUF_ENCODING_RAW]    = "raw",
+    [MAT_BUF_ENCODING_VARINT] = "varint",
+};
+static ssize_t dev_attr_buffers_encoding_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* list all encodings, mark selected one with brackets */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    int encoding;
+    for(encoding=0; encoding<MAT_BUF_ENCODING_NUM; encoding++)
+    {
+        if(encoding == gk_mat_buffers_encoding)
+        {
+            MAT_WRITE_BUF( "[%s] ", gm_encoding_names[encoding]);
+        }
+        else
+        {
+            MAT_WRITE_BUF( "%s ", gm_encoding_names[encoding]);
+        }
+    }
+    MAT_WRITE_BUF( "\n");
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_encoding_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* accept name or number of encoding */
+    int encoding;
+
+    for(encoding=0; encoding<MAT_BUF_ENCODING_NUM; encoding++)
+    {
+        if(sysfs_streq(buf, gm_encoding_names[encoding]))
+        {
+            break;
+        }
+    }
+    if(encoding == MAT_BUF_ENCODING_NUM && (sscanf(buf, "%d", &encoding) != 1 || encoding < 0 || encoding >= MAT_BUF_ENCODING_NUM))
+    {
+        return -EINVAL;
+    }
+    if(encoding != MAT_BUF_ENCODING_RAW && gk_mat_buffers_policy == MAT_BUF_POLICY_RESERVOIR)
+    {
+        MAT_MERR_FUNC( "reservoir needs raw encoding" );
+        return -EINVAL;
+    }
+#ifdef MAT_ADDR_STREAM
+    if(encoding != MAT_BUF_ENCODING_RAW && gk_mat_buffers_stream)
+    {
+        MAT_MERR_FUNC( "stream needs raw encoding" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_STREAM */
+#ifdef MAT_ADDR_RECORDS
+    if(encoding != MAT_BUF_ENCODING_RAW && gk_mat_buffers_schema)
+    {
+        MAT_MERR_FUNC( "record schema needs raw encoding" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_RECORDS */
+#ifdef MAT_ADDR_POOL
+    if(encoding != MAT_BUF_ENCODING_RAW && gk_mat_buffers_pool)
+    {
+        MAT_MERR_FUNC( "pool needs raw encoding" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_POOL */
+    MAT_MDBG_FUNC( "count=%ld encoding=%d", count, encoding );
+
+    /* content of buffers is dropped when switching encoding */
+    down_write(&gm_corebuffer_rwsem);
+    /* switch encoding only while producer does not insert */
+    if(gk_mat_buffers_enabled)
+    {
+        up_write(&gm_corebuffer_rwsem);
+        MAT_MERR_FUNC( "disable buffers before switching encoding" );
+        return -EBUSY;
+    }
+    /* PMIs that saw buffers enabled may still insert */
+    synchronize_rcu();
+    gk_mat_buffers_encoding = encoding;
+    buffers_clear();
+    up_write(&gm_corebuffer_rwsem);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_encoding, S_IRUSR | S_IWUSR, dev_attr_buffers_encoding_show, dev_attr_buffers_encoding_store);
+#endif /* MAT_ADDR_ENCODING */
+
+#ifdef MAT_ADDR_RECORDS
+/* names of record fields in order of bits (MAT_REC_*) */
+static const char* const gm_schema_names[MAT_REC_NUM] = {
+    "tsc", "ip", "tid", "weight", "data_src", "period",
+};
+static ssize_t dev_attr_buffers_schema_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* fields of a record in the order they are stored, each field is a u64 */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    int field;
+    MAT_WRITE_BUF( "addr");
+    for(field=0; field<MAT_REC_NUM; field++)
+    {
+        if(gk_mat_buffers_schema & (1 << field))
+        {
+            MAT_WRITE_BUF( " %s", gm_schema_names[field]);
+        }
+    }
+    MAT_WRITE_BUF( "\n");
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_buffers_schema_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * accept bit mask of fields (MAT_REC_*) or names of fields
+     * separated by spaces or commas, e.g., "tsc ip tid".
+     * address is always the first field of a record.
+     */
+    char* args;
+    char* cursor;
+    char* token;
+    int schema;
+    int field;
+
+    if(kstrtoint(buf, 0, &schema) == 0)
+    {
+        if(schema < 0 || schema > MAT_REC_MASK)
+        {
+            return -EINVAL;
+        }
+    }
     else
     {
-        gm_corebuffer_bytes = 0;
+        args = kstrndup(buf, count, GFP_KERNEL);
+        if(!args)
+        {
+            return -ENOMEM;
+        }
+        schema = 0;
+        cursor = args;
+        while((token = strsep(&cursor, " ,\n")) != NULL)
+        {
+            if(*token == '\0' || strcmp(token, "addr") == 0)
+            {
+                continue;
+            }
+            for(field=0; field<MAT_REC_NUM; field++)
+            {
+                if(strcmp(token, gm_schema_names[field]) == 0)
+                {
+                    schema |= (1 << field);
+                    break;
+                }
+            }
+            if(field == MAT_REC_NUM)
+            {
+                MAT_MERR_FUNC( "unknown field %s", token );
+                kfree(args);
+                return -EINVAL;
+            }
+        }
+        kfree(args);
+    }
+    if(schema && gk_mat_buffers_policy == MAT_BUF_POLICY_RESERVOIR)
+    {
+        MAT_MERR_FUNC( "reservoir needs empty record schema" );
+        return -EINVAL;
     }
+#ifdef MAT_ADDR_ENCODING
+    if(schema && gk_mat_buffers_encoding != MAT_BUF_ENCODING_RAW)
+    {
+        MAT_MERR_FUNC( "record schema needs raw encoding" );
+        return -EINVAL;
+    }
+#endif /* MAT_ADDR_ENCODING */
+    MAT_MDBG_FUNC( "count=%ld schema=%x", count, schema );
 
-    if(gm_corebuffer_bytes >= 0)
+    /* content of buffers is dropped when switching schema */
+    down_write(&gm_corebuffer_rwsem);
+    /* switch schema only while producer does not insert */
+    if(gk_mat_buffers_enabled)
     {
-        MAT_WRITE_BUF( "%ld\n", gm_corebuffer_bytes);
+        up_write(&gm_corebuffer_rwsem);
+        MAT_MERR_FUNC( "disable buffers before switching record schema" );
+        return -EBUSY;
     }
+    /* PMIs that saw buffers enabled may still insert */
+    synchronize_rcu();
+    gk_mat_buffers_schema = schema;
+    buffers_clear();
+#ifdef MAT_ADDR_STREAM
+    stream_reset();
+#endif /* MAT_ADDR_STREAM */
+    up_write(&gm_corebuffer_rwsem);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(buffers_schema, S_IRUSR | S_IWUSR, dev_attr_buffers_schema_show, dev_attr_buffers_schema_store);
+#endif /* MAT_ADDR_RECORDS */
+
+
 
+#ifdef MAT_ADDR_TAGS
+static ssize_t dev_attr_buffers_tags_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* one line per tag: tag and config of its event */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    u32 i;
+    for(i=0; i<gk_mat_tags.num; i++)
+    {
+        MAT_WRITE_BUF( "%u 0x%llx\n", i + 1, gk_mat_tags.configs[i]);
+    }
     MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
     return (buf - buf_begin);
 }
-static ssize_t dev_attr_buffers_bytes_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+static ssize_t dev_attr_buffers_tags_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-    return -EROFS;
+    /*
+     * accept configs of events (perf_event_attr.config, e.g., 0x81d0 for
+     * loads and 0x82d0 for stores) separated by spaces or commas, the n-th
+     * config gets tag n. an empty list disables tags.
+     */
+    struct mat_tags tags;
+    char* args;
+    char* cursor;
+    char* token;
+
+    memset(&tags, 0, sizeof(tags));
+    args = kstrndup(buf, count, GFP_KERNEL);
+    if(!args)
+    {
+        return -ENOMEM;
+    }
+    cursor = args;
+    while((token = strsep(&cursor, " ,\n")) != NULL)
+    {
+        if(*token == '\0')
+        {
+            continue;
+        }
+        if(tags.num == MAT_TAG_EVENTS)
+        {
+            MAT_MERR_FUNC( "at most %d events", MAT_TAG_EVENTS );
+            kfree(args);
+            return -EINVAL;
+        }
+        if(kstrtou64(token, 0, &tags.configs[tags.num]) != 0)
+        {
+            MAT_MERR_FUNC( "invalid config %s", token );
+            kfree(args);
+            return -EINVAL;
+        }
+        tags.num++;
+    }
+    kfree(args);
+    MAT_MDBG_FUNC( "count=%ld num=%u", count, tags.num );
+
+    /* addresses in buffers would mix tagged and untagged samples */
+    down_write(&gm_corebuffer_rwsem);
+    /* switch tags only while producer does not insert */
+    if(gk_mat_buffers_enabled)
+    {
+        up_write(&gm_corebuffer_rwsem);
+        MAT_MERR_FUNC( "disable buffers before switching tags" );
+        return -EBUSY;
+    }
+    /* PMIs that saw buffers enabled may still insert */
+    synchronize_rcu();
+    gk_mat_tags = tags;
+    buffers_clear();
+#ifdef MAT_ADDR_STREAM
+    stream_reset();
+#endif /* MAT_ADDR_STREAM */
+    up_write(&gm_corebuffer_rwsem);
+    return count;
 }
 /* create device attribute dev_attr_<name> */
-static DEVICE_ATTR(buffers_bytes, S_IRUSR | S_IWUSR, dev_attr_buffers_bytes_show, dev_attr_buffers_bytes_store);
+static DEVICE_ATTR(buffers_tags, S_IRUSR | S_IWUSR, dev_attr_buffers_tags_show, dev_attr_buffers_tags_store);
+#endif /* MAT_ADDR_TAGS */
 
 
 
@@ -421,6 +1537,13 @@ static DEVICE_ATTR(buffers_bytes, S_IRUSR | S_IWUSR, dev_attr_buffers_bytes_show
 int corebuffer_setup_devattr(void)
 {
     int rval;
+
+    gm_mmap_headers = kcalloc(nr_cpu_ids, sizeof(struct page*), GFP_KERNEL);
+    if(!gm_mmap_headers)
+    {
+        MAT_MERR_FUNC( "failed to allocate header pages" );
+        return -1;
+    }
     rval = device_create_file(gm_device, &dev_attr_buffers_enabled);
     if (rval < 0)
     {
@@ -437,7 +1560,6 @@ int corebuffer_setup_devattr(void)
     }
     MAT_MDBG_FUNC( "created %s", dev_attr_buffers.attr.name );
 
-    gm_corebuffer_bytes = 0;
     rval = device_create_file(gm_device, &dev_attr_buffers_bytes);
     if (rval < 0)
     {
@@ -445,6 +1567,82 @@ int corebuffer_setup_devattr(void)
         return -1;
     }
     MAT_MDBG_FUNC( "created %s", dev_attr_buffers_bytes.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_buffers_hugepages);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_hugepages.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_hugepages.attr.name );
+
+#ifdef MAT_ADDR_POOL
+    rval = device_create_file(gm_device, &dev_attr_buffers_pool);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_pool.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_pool.attr.name );
+#endif /* MAT_ADDR_POOL */
+
+    rval = device_create_file(gm_device, &dev_attr_buffers_policy);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_policy.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_policy.attr.name );
+
+#ifdef MAT_ADDR_STREAM
+    cpumask_clear(&gm_stream_readers);
+    stream_reset();
+    rval = device_create_file(gm_device, &dev_attr_buffers_stream);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_stream.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_stream.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_buffers_watermark);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_watermark.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_watermark.attr.name );
+#endif /* MAT_ADDR_STREAM */
+
+#ifdef MAT_ADDR_ENCODING
+    rval = device_create_file(gm_device, &dev_attr_buffers_encoding);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_encoding.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_encoding.attr.name );
+#endif /* MAT_ADDR_ENCODING */
+
+#ifdef MAT_ADDR_RECORDS
+    rval = device_create_file(gm_device, &dev_attr_buffers_schema);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_schema.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_schema.attr.name );
+#endif /* MAT_ADDR_RECORDS */
+
+#ifdef MAT_ADDR_TAGS
+    rval = device_create_file(gm_device, &dev_attr_buffers_tags);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_buffers_tags.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_buffers_tags.attr.name );
+#endif /* MAT_ADDR_TAGS */
     return 0;
 }
 
@@ -453,184 +1651,401 @@ int corebuffer_setup_devattr(void)
 void corebuffer_reset(void)
 {
     gk_mat_buffers_enabled = 0;
+    gk_mat_buffers_policy = MAT_BUF_POLICY_STOP;
+#ifdef MAT_ADDR_ENCODING
+    gk_mat_buffers_encoding = MAT_BUF_ENCODING_RAW;
+#endif /* MAT_ADDR_ENCODING */
+#ifdef MAT_ADDR_RECORDS
+    gk_mat_buffers_schema = 0;
+#endif /* MAT_ADDR_RECORDS */
+#ifdef MAT_ADDR_TAGS
+    gk_mat_tags.num = 0;
+#endif /* MAT_ADDR_TAGS */
+#ifdef MAT_ADDR_STREAM
+    gk_mat_buffers_stream = 0;
+    stream_wakeup_all();
+#endif /* MAT_ADDR_STREAM */
+    down_write(&gm_corebuffer_rwsem);
+    /* producers (NMIs) may still insert into buffers */
+    synchronize_rcu();
+#ifdef MAT_ADDR_POOL
+    pool_destroy();
+#endif /* MAT_ADDR_POOL */
     destoy_allbuffers();
+    gm_buffers_hugepages = false;
+    up_write(&gm_corebuffer_rwsem);
+    /* mappings hold their own reference of header pages */
+    if(gm_mmap_headers)
+    {
+        int cpu;
+        for_each_possible_cpu(cpu)
+        {
+            if(gm_mmap_headers[cpu])
+            {
+                __free_page(gm_mmap_headers[cpu]);
+            }
+        }
+        kfree(gm_mmap_headers);
+        gm_mmap_headers = NULL;
+    }
 }
 
 
 
-size_t corebuffer_read(char **p_buf, size_t *p_len, loff_t **p_off)
+ssize_t corebuffer_read(int cpu, struct iov_iter *to, loff_t *off)
 {
-    /* create temporary parameters */
-    char* buf = *p_buf;
-    size_t len = *p_len;
-    loff_t* off = *p_off;
-    size_t result = -ENODATA;
+    /*
+     * we read data from multiple buffers of core with id @cpu.
+     * number of available bytes is the sum of all buffers, visible
+     * by reading "buffers_bytes" from user perspective.
+     * the offset @off refers to buffers space of
+     * buffers 1 to N (in order from oldest to newest buffer),
+     * so positioned reads (pread) locate their buffer directly.
+     */
+    const size_t len = iov_iter_count(to);
+    struct mat_buffers* buffers;
+    u64 sizes[MAT_BUF_NUM];
+    u64 buffer_off;
+    size_t bytes;
+    ssize_t result;
+    u32 idx;
 
-    if(gk_mat_buffers_enabled)
+    /* make sure that selected CPU @cpu is valid */
+    if(!utilities_cpu_valid(cpu))
     {
-        /*
-         * we read data from multiple buffers of core with id @gm_cpu.
-         * number of available bytes is the sum of all buffers, visible
-         * by reading @gm_corebuffer_bytes from user
-         * perspective. the offset @off refers to buffers space of
-         * buffers 1 to N (in that order).
-         */
-        const int CPUS = num_online_cpus();
-        ssize_t bytes;
-        int rval;
-        struct mat_buffers* buffers;
-        struct mat_buffer* buffer;
-        char* src;
-        char* buffer_end;
-        u64 buffer_off;
-        u64 total_size;
-        u32 idx, selected_idx;
+        MAT_MERR_FUNC( "len=%ld off=%lld cpu=%d", len, *off, cpu );
+        return -EFAULT;
+    }
 
-        buffer_off = *off;
-        bytes = 0;
-        rval  = 0;
-        MAT_MDBG_FUNC( "buf=%px len=%ld off=%lld bytes=%ld", buf, len, *off, bytes );
+    down_read(&gm_corebuffer_rwsem);
+    if(!gk_mat_buffers_enabled)
+    {
+        MAT_MERR_FUNC( "MAT_ADDR_BUFFERS disabled" );
+        result = -ENODATA; goto exit;
+    }
+    buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+#ifdef MAT_ADDR_POOL
+    /* chunks of a core are not contiguous, walk chain */
+    if(gk_mat_buffers_pool)
+    {
+        result = pool_read(buffers, to, off); goto exit;
+    }
+#endif /* MAT_ADDR_POOL */
 
-        /* make sure that selected CPU @gm_cpu is valid */
-        if(gm_cpu < 0 || gm_cpu >= CPUS)
+    /*
+     * bytes of buffers from oldest to newest, make sure data exists.
+     * the producer may append samples meanwhile, we read the
+     * sizes once, so a read is consistent with itself.
+     */
+    for(idx=0; idx<MAT_BUF_NUM; idx++)
+    {
+        const struct mat_buffer* buffer = &(buffers->buffers[buffers_order(buffers, idx)]);
+        if(!buffer->data)
         {
-            MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld gm_cpu=%d CPUS=%d", buf, len, *off, bytes, gm_cpu, CPUS );
-            result = -EFAULT; goto exit;
+            MAT_MERR_FUNC( "len=%ld off=%lld idx=%d data=%px", len, *off, idx, buffer->data );
+            result = -ENODATA; goto exit;
         }
-        buffers = per_cpu_ptr(&cpu_mat_buffers, gm_cpu);
+        sizes[idx] = READ_ONCE(buffer->size) * sizeof(u64);
+    }
 
-        if(!buffers)
+    /* find buffer of offset @off, @buffer_off is the offset inside this buffer */
+    buffer_off = *off;
+    for(idx=0; idx<MAT_BUF_NUM && buffer_off >= sizes[idx]; idx++)
+    {
+        buffer_off -= sizes[idx];
+    }
+
+    /* copy until @len bytes are read or end of newest buffer is reached */
+    bytes = 0;
+    for(; idx<MAT_BUF_NUM && bytes < len; idx++)
+    {
+        struct mat_buffer* buffer = &(buffers->buffers[buffers_order(buffers, idx)]);
+        const size_t copy_bytes = min_t(u64, sizes[idx] - buffer_off, len - bytes);
+        /*
+         * always copy: pages passed to a pipe by reference would need to be
+         * up to date page cache pages, and samples may be rewritten later.
+         * splice (generic_file_splice_read) still avoids a copy to user space.
+         */
+        const size_t copied = copy_to_iter((char*)buffer->data + buffer_off, copy_bytes, to);
+
+        bytes += copied;
+        if(copied < copy_bytes)
         {
-            MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld buffers=%px", buf, len, *off, bytes, buffers) ;
-            result = -ENODATA; goto exit;
+            /* faulted or pipe full: return what was copied so far */
+            MAT_MDBG_FUNC( "len=%ld off=%lld bytes=%ld idx=%u copied=%ld", len, *off, bytes, idx, copied );
+            break;
         }
+        buffer_off = 0;
+    }
+    if(!bytes && len && idx < MAT_BUF_NUM)
+    {
+        result = -EFAULT; goto exit;
+    }
 
-        /* compute size of all buffers together, make sure data exists */
-        total_size = 0;
-        for(idx=0; idx<MAT_BUF_NUM; idx++)
+    *off += bytes;
+    MAT_MDBG_FUNC( "len=%ld off=%lld bytes=%ld", len, *off, bytes );
+    result = bytes;
+exit:
+    /* keep header of mappings current */
+    mmap_header_refresh(cpu);
+    up_read(&gm_corebuffer_rwsem);
+    return result;
+}
+
+
+
+int corebuffer_mmap(int cpu, struct vm_area_struct *vma)
+{
+    /*
+     * map buffers of core with id @cpu read-only into user space.
+     * offset 0 of the mapping is a header page (struct mat_mmap_header),
+     * followed by the data of buffers 1 to N (in that order). we map
+     * pages as long as the mapping is large enough, so user space can
+     * map the header page first to learn the size of the whole mapping.
+     * mapped pages hold a reference, i.e., deleting the buffers while
+     * they are mapped does not free pages before they are unmapped.
+     */
+    struct mat_buffers* buffers;
+    struct mat_mmap_header* header;
+    struct page* header_page;
+    unsigned long uaddr;
+    u32 idx;
+    int rval;
+
+    MAT_MDBG_FUNC( "start=%lx end=%lx pgoff=%lu cpu=%d", vma->vm_start, vma->vm_end, vma->vm_pgoff, cpu );
+
+    /* make sure that selected CPU @cpu is valid */
+    if(!utilities_cpu_valid(cpu))
+    {
+        MAT_MERR_FUNC( "cpu=%d", cpu );
+        return -EINVAL;
+    }
+    /* mapping has to start with header page */
+    if(vma->vm_pgoff != 0)
+    {
+        MAT_MERR_FUNC( "pgoff=%lu", vma->vm_pgoff );
+        return -EINVAL;
+    }
+    /* read-only mapping */
+    if(vma->vm_flags & VM_WRITE)
+    {
+        return -EPERM;
+    }
+#ifdef MAT_ADDR_POOL
+    /* header describes MAT_BUF_NUM buffers, not chains of chunks */
+    if(gk_mat_buffers_pool)
+    {
+        MAT_MERR_FUNC( "mmap not supported in pool mode, use read" );
+        return -EOPNOTSUPP;
+    }
+#endif /* MAT_ADDR_POOL */
+    vma->vm_flags &= ~VM_MAYWRITE;
+    vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+    /*
+     * hold buffers while mapping their pages. we are called with mmap_sem
+     * held, while readers hold the lock across copies to user space, which
+     * may fault and take mmap_sem. with a writer waiting, blocking here
+     * would deadlock, so give up instead (buffers are being replaced).
+     */
+    if(!down_read_trylock(&gm_corebuffer_rwsem))
+    {
+        MAT_MERR_FUNC( "buffers are being changed, try again" );
+        return -EAGAIN;
+    }
+    buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+
+    /* header page of core is shared by all its mappings */
+    header_page = READ_ONCE(gm_mmap_headers[cpu]);
+    if(!header_page)
+    {
+        struct page* new_page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+        if(!new_page)
         {
-            buffer = &(buffers->buffers[idx]);
-            total_size += buffer->size;
-            if(!buffer->data)
-            {
-                MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld idx=%d data=%px", buf, len, *off, bytes, idx, buffer->data );
-                result = -ENODATA; goto exit;
-            }
+            MAT_MERR_FUNC( "failed alloc_page" );
+            rval = -ENOMEM; goto exit;
         }
-
-        /* check if requestes bytes @len are avaiable in buffers, excluding @off offset */
-        if(len > (total_size * sizeof(u64)) - *off )
+        header = (struct mat_mmap_header*) page_address(new_page);
+        header->magic   = MAT_MMAP_MAGIC;
+        header->cpu     = cpu;
+        header->buf_num = MAT_BUF_NUM;
+        /* concurrent mmap of same core may have installed its page first */
+        header_page = cmpxchg(&gm_mmap_headers[cpu], NULL, new_page);
+        if(header_page)
+        {
+            __free_page(new_page);
+        }
+        else
         {
-            MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld total_size=%lld", buf, len, *off, bytes, total_size );
-            result = -EFAULT; goto exit;
+            header_page = new_page;
         }
+    }
+    mmap_header_refresh(cpu);
 
-        /*
-         * get index of buffer that corresponds to offset @off
-         * we also save in @buffer_off the offset for the first buffer we read
-         */
-        selected_idx = 0;
+    /* mapping takes its own reference of header page */
+    uaddr = vma->vm_start;
+    rval = vm_insert_page(vma, uaddr, header_page);
+    if(rval < 0)
+    {
+        MAT_MERR_FUNC( "failed vm_insert_page header rval=%d", rval );
+        goto exit;
+    }
+    uaddr += PAGE_SIZE;
+
+    /* map pages of buffers */
+    for(idx=0; idx<MAT_BUF_NUM && uaddr < vma->vm_end; idx++)
+    {
+        struct mat_buffer* buffer = &(buffers->buffers[idx]);
+        const u64 buffer_bytes = PAGE_ALIGN(buffer->capacity * sizeof(u64));
+        u64 buffer_off;
+
+        if(!buffer->data)
         {
-            u64 tmp = 0;
-            for(idx=0; idx<MAT_BUF_NUM; idx++)
+            continue;
+        }
+        for(buffer_off=0; buffer_off<buffer_bytes && uaddr < vma->vm_end; buffer_off+=PAGE_SIZE)
+        {
+            rval = vm_insert_page(vma, uaddr, buffer_page(buffer, buffer_off));
+            if(rval < 0)
             {
-                buffer = &(buffers->buffers[idx]);
-                tmp += buffer->size * sizeof(u64);
-                if(*off < tmp)
-                {
-                    selected_idx = idx;
-                    break;
-                }
-                else
-                {
-                    buffer_off -= buffer->size * sizeof(u64);
-                }
+                MAT_MERR_FUNC( "failed vm_insert_page idx=%u buffer_off=%llu rval=%d", idx, buffer_off, rval );
+                goto exit;
             }
+            uaddr += PAGE_SIZE;
         }
+    }
 
-        buffer = &(buffers->buffers[selected_idx]);
-        /* check that offset is inside buffer (redundant) */
-        if(buffer_off >= (buffer->size * sizeof(u64)))
-        {
-            MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld buffer_bytes=%lld buffer_off=%lld", buf, len, *off, bytes, (buffer->size * sizeof(u64)), buffer_off );
-            result = -EFAULT; goto exit;
-        }
-        MAT_MDBG_FUNC( "buf=%px len=%ld off=%lld bytes=%ld data=%px end=%px selected_idx=%d buffer_off=%lld", buf, len, *off, bytes, buffer->data, buffer->data + buffer->size, selected_idx, buffer_off );
+    MAT_MDBG_FUNC( "mapped %lu bytes", uaddr - vma->vm_start );
+    rval = 0;
+exit:
+    up_read(&gm_corebuffer_rwsem);
+    return rval;
+}
 
-        /*
-         * WARNING: we have u64 pointer but byte offset. they are incompatible.
-         * set cursor @src to start reading from offset @buffer_off
-         * set cursor @buffer_end to mark end of buffer
-         */
-        src        = (char*)buffer->data + buffer_off;
-        buffer_end = (char*)buffer->data + (buffer->size * sizeof(u64));
 
-        /* check cursor (redundant) */
-        if(src >= buffer_end)
+
+#ifdef MAT_ADDR_STREAM
+ssize_t corebuffer_stream_read(int cpu, struct iov_iter *to, bool nonblock)
+{
+    /*
+     * consume elements of ring of core with id @cpu, starting at @tail.
+     * offsets are ignored, every element is read exactly once.
+     * block until @watermark elements are available, unless @nonblock.
+     * if streaming stops, return remaining elements, then end of file.
+     * elements are copied, since the producer reuses their space.
+     */
+    const size_t len = iov_iter_count(to);
+    struct mat_buffers* buffers;
+    u64 elements;
+    u64 available;
+    u64 copied;
+    ssize_t rval;
+
+    MAT_MDBG_FUNC( "cpu=%d len=%ld nonblock=%d", cpu, len, nonblock );
+
+    /* make sure that selected CPU @cpu is valid */
+    if(!utilities_cpu_valid(cpu))
+    {
+        MAT_MERR_FUNC( "cpu=%d", cpu );
+        return -EFAULT;
+    }
+    /* we only read whole elements */
+    elements = len / sizeof(u64);
+    if(!elements)
+    {
+        return -EINVAL;
+    }
+    buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+
+    /* single consumer per ring */
+    if(cpumask_test_and_set_cpu(cpu, &gm_stream_readers))
+    {
+        return -EBUSY;
+    }
+
+    if(!nonblock)
+    {
+        rval = wait_event_interruptible(buffers->wait,
+            stream_available(buffers) >= READ_ONCE(buffers->watermark) || !stream_active());
+        if(rval)
         {
-            MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld src=%px buffer_end=%px", buf, len, *off, bytes, src, buffer_end );
-            result = -EFAULT; goto exit;
+            goto exit;
         }
+    }
 
-        /*
-         * read as long as we have read @bytes bytes from buffer
-         * equal to @len bytes requested by user
-         */
-        while(bytes < len)
-        {
-            /* we copy the minimum of: bytes left in buffer and remaining bytes to read */
-            const size_t copy_bytes = min((size_t)(buffer_end - src), (len - bytes));
-            /*
-             * copy_to_user returns #bytes left to copy. 0 means success.
-             * see: include/linux/uaccess.h
-             */
-            rval = copy_to_user(buf, src, copy_bytes);
-            /* error */
-            if (rval < 0)
-            {
-                MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld rval=%d src=%px", buf, len, *off, bytes, rval, src );
-                result = -EFAULT; goto exit;
-            }
-            /* for whatever reason @rval bytes were not copied. */
-            if( rval > 0 )
-            {
-                src   += copy_bytes - rval;
-                /* we don't handle this case (not tested). abort. */
-                MAT_MERR_FUNC( "rval=%d", rval );
-                result = -EFAULT; goto exit;
-            }
-            bytes += copy_bytes - rval;
-            buf += bytes;
+    down_read(&gm_corebuffer_rwsem);
+    copied = 0;
+    available = stream_available(buffers);
+    if(available && buffers->buffers[0].data)
+    {
+        const u64 capacity = buffers->buffers[0].capacity;
+        u64 tail = buffers->tail;
 
-            MAT_MDBG_FUNC( "idx=%u buf=%px len=%ld off=%lld bytes=%ld rval=%d\n", selected_idx, buf, len, *off, bytes, rval );
+        elements = min(elements, available);
+        while(copied < elements)
+        {
+            /* copy up to end of buffer that holds @tail */
+            const u64 pos = tail % (capacity * MAT_BUF_NUM);
+            const u32 idx = pos / capacity;
+            const u64 off = pos % capacity;
+            const u64 copy_elements = min(elements - copied, capacity - off);
 
-            if(bytes < len && rval == 0)
+            if(copy_to_iter(buffers->buffers[idx].data + off, copy_elements * sizeof(u64), to) != copy_elements * sizeof(u64))
             {
-                selected_idx++;
-                /* test if we reached end of our buffers. */
-                if(selected_idx >= MAT_BUF_NUM)
-                {
-                    MAT_MERR_FUNC( "buf=%px len=%ld off=%lld bytes=%ld rval=%d selected_idx=%d", buf, len, *off, bytes, rval, selected_idx );
-                    result = -EFAULT; goto exit;
-                }
-                buffer = &(buffers->buffers[selected_idx]);
-                src      = (char*)buffer->data;
-                buffer_end = (char*)buffer->data + (buffer->size * sizeof(u64));
+                MAT_MERR_FUNC( "cpu=%d copied=%lld idx=%u off=%lld", cpu, copied, idx, off );
+                break;
             }
+            copied += copy_elements;
+            tail   += copy_elements;
         }
-
-        *off += bytes;
-        MAT_MDBG_FUNC( "buf=%px len=%ld off=%lld bytes=%ld", buf, len, *off, bytes );
-        result = bytes; goto exit;
+        /* pairs with smp_load_acquire in producer: elements are read */
+        smp_store_release(&(buffers->tail), tail);
+        rval = copied ? copied * sizeof(u64) : -EFAULT;
     }
+    else
+    {
+        /* nothing available: try again or end of file */
+        rval = stream_active() ? -EAGAIN : 0;
+    }
+    up_read(&gm_corebuffer_rwsem);
 
-    MAT_MERR_FUNC( "MAT_ADDR_BUFFERS disabled" );
 exit:
-    /* set parameters */
-    *p_buf = buf;
-    *p_len = len;
-    *p_off = off;
-    return result;
+    cpumask_clear_cpu(cpu, &gm_stream_readers);
+    MAT_MDBG_FUNC( "cpu=%d rval=%ld", cpu, rval );
+    return rval;
 }
-#endif /* MAT_ADDR_BUFFERS */
+#endif /* MAT_ADDR_STREAM */
 
+
+
+__poll_t corebuffer_poll(int cpu, struct file *file, poll_table *wait)
+{
+    if(!utilities_cpu_valid(cpu))
+    {
+        return EPOLLERR;
+    }
+    /* cheap refresh of header of mappings, e.g., poll with timeout 0 */
+    if(down_read_trylock(&gm_corebuffer_rwsem))
+    {
+        mmap_header_refresh(cpu);
+        up_read(&gm_corebuffer_rwsem);
+    }
+#ifdef MAT_ADDR_STREAM
+    if(gk_mat_buffers_stream)
+    {
+        struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        u64 available;
+
+        poll_wait(file, &(buffers->wait), wait);
+        available = stream_available(buffers);
+        if(available >= READ_ONCE(buffers->watermark) || (available && !stream_active()))
+        {
+            return EPOLLIN | EPOLLRDNORM;
+        }
+        return stream_active() ? 0 : EPOLLHUP;
+    }
+#endif /* MAT_ADDR_STREAM */
+    /* without streaming, buffers can be read at any time */
+    return EPOLLIN | EPOLLRDNORM;
+}
+#endif /* MAT_ADDR_BUFFERS */
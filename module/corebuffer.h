@@ -2,15 +2,62 @@
 #define _MAT_COREBUFFER_H
 
 #include <linux/mat.h>
+#include <linux/fs.h>   /* file, vm_area_struct */
+#include <linux/poll.h> /* poll_table */
+#include <linux/uio.h>  /* iov_iter */
 
 #define BUFFER_LIMIT (0x10000000000ull) /* let size of all CPU buffers not exceed 128 GiB */
 
+/* with buffers_hugepages, buffers consist of blocks mapped by a single huge page (2 MiB) */
+#define BUFFER_BLOCK_SHIFT (PMD_SHIFT)
+#define BUFFER_BLOCK_SIZE  (1ul << BUFFER_BLOCK_SHIFT)
+#define BUFFER_BLOCK_ORDER (BUFFER_BLOCK_SHIFT - PAGE_SHIFT)
+
 #ifdef MAT_ADDR_BUFFERS
-extern ssize_t gm_corebuffer_bytes;
+/*
+ * layout of the first page of a mapping of the device (see corebuffer_mmap).
+ * the header page is followed by the data of every buffer of the
+ * selected core. data of each buffer starts at a page-aligned offset.
+ * @size and @capacity count u64 elements, @offset counts bytes.
+ * @schema is the record schema (MAT_REC_*), a record consists of
+ * mat_record_words(@schema) elements.
+ * the header page is shared by all mappings of the core. @size and
+ * @buf_idx are refreshed by mmap, read and poll (e.g., with timeout 0)
+ * of the core, the other values change only by reconfiguring buffers.
+ * @generation is incremented when buffers of the core are freed, pages
+ * mapped before then are stale and the core has to be mapped again.
+ * with policy MAT_BUF_POLICY_OVERWRITE, buffer (@buf_idx + 1) % @buf_num
+ * holds the oldest samples.
+ */
+#define MAT_MMAP_MAGIC (0x50414d4d5f54414dull) /* "MAT_MMAP" in little endian */
+#define MAT_MMAP_FORMAT_RAW    0 /* one u64 address per element */
+#define MAT_MMAP_FORMAT_VARINT 1 /* delta + varint encoded bytes (see MAT_BUF_ENCODING_VARINT) */
+struct mat_mmap_header
+{
+    u64 magic;
+    s32 cpu;
+    u32 buf_num;
+    u32 buf_idx;
+    u32 format;
+    u32 policy;
+    u32 schema;
+    u64 generation;
+    struct
+    {
+        u64 offset;
+        u64 size;
+        u64 capacity;
+    } buffers[MAT_BUF_NUM];
+};
 
 int corebuffer_setup_devattr(void);
 void corebuffer_reset(void);
-size_t corebuffer_read(char **p_buf, size_t *p_len, loff_t **p_off);
+ssize_t corebuffer_read(int cpu, struct iov_iter *to, loff_t *off);
+int corebuffer_mmap(int cpu, struct vm_area_struct *vma);
+__poll_t corebuffer_poll(int cpu, struct file *file, poll_table *wait);
+#ifdef MAT_ADDR_STREAM
+ssize_t corebuffer_stream_read(int cpu, struct iov_iter *to, bool nonblock);
+#endif /* MAT_ADDR_STREAM */
 #endif /* MAT_ADDR_BUFFERS */
 
 #endif /* _MAT_COREBUFFER_H */
@@ -0,0 +1,666 @@
+#include "filter.h"
+
+#include <linux/device.h>  /* device (attriutes) */
+#include <linux/cpumask.h> /* nr_cpu_ids, num_online_cpus */
+#include <linux/slab.h>    /* kzalloc, kfree */
+#include <linux/mutex.h>   /* mutex_lock/unlock */
+#include <linux/sort.h>    /* sort */
+#include <linux/cgroup.h>  /* cgroup_get_from_path, cgroup_put */
+#include <linux/percpu.h>  /* alloc_percpu, free_percpu */
+
+#include "utilities.h"
+
+#if defined(MAT_FILTER_TASK) || defined(MAT_FILTER_ADDR) || defined(MAT_FILTER_MEM)
+/* serializes writers of filters of the kernel and of their configuration */
+static DEFINE_MUTEX(gm_filter_mutex);
+#endif /* MAT_FILTER_TASK || MAT_FILTER_ADDR || MAT_FILTER_MEM */
+
+
+
+#ifdef MAT_FILTER_TASK
+/* configuration of task filter, published to the kernel on every change */
+static pid_t gm_filter_tgids[MAT_FILTER_TGIDS];
+static u32 gm_filter_num = 0;
+static bool gm_filter_children = false;
+static struct cgroup* gm_filter_cgrp = NULL;
+static char gm_filter_cgroup_path[256] = "";
+
+
+
+static void task_filter_destroy(struct mat_task_filter* filter)
+{
+    if(filter)
+    {
+        if(filter->cgrp)
+        {
+            cgroup_put(filter->cgrp);
+        }
+        kfree(filter);
+    }
+}
+
+
+
+/*
+ * build filter of a configuration in @filter (NULL if neither tgids nor
+ * cgroup are set). stores build the filter of their new configuration
+ * first and change the module state only if this succeeded.
+ */
+static int task_filter_create(const pid_t* tgids, u32 num, bool children, struct cgroup* cgrp, struct mat_task_filter** filter)
+{
+    *filter = NULL;
+    if(!num && !cgrp)
+    {
+        return 0;
+    }
+    *filter = kzalloc(sizeof(struct mat_task_filter), GFP_KERNEL);
+    if(!*filter)
+    {
+        MAT_MERR_FUNC( "failed kzalloc" );
+        return -ENOMEM;
+    }
+    (*filter)->num      = num;
+    (*filter)->children = children;
+    memcpy((*filter)->tgids, tgids, num * sizeof(pid_t));
+    (*filter)->cgrp     = cgrp;
+    if(cgrp)
+    {
+        /* filter holds its own reference */
+        cgroup_get(cgrp);
+    }
+    return 0;
+}
+
+
+
+/*
+ * publish @filter to the kernel and free previous filter after readers
+ * finished. called with @gm_filter_mutex held.
+ */
+static void task_filter_publish(struct mat_task_filter* filter)
+{
+    struct mat_task_filter* old;
+
+    old = rcu_dereference_protected(gk_mat_task_filter, lockdep_is_held(&gm_filter_mutex));
+    rcu_assign_pointer(gk_mat_task_filter, filter);
+    /* producer (NMI) may still use @old */
+    synchronize_rcu();
+    task_filter_destroy(old);
+}
+
+
+
+static int cmp_pid(const void* a, const void* b)
+{
+    const pid_t x = *(const pid_t*)a;
+    const pid_t y = *(const pid_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+
+/*
+ * device attribute functions for managing filters
+ */
+static ssize_t dev_attr_filter_tgids_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    u32 i;
+
+    mutex_lock(&gm_filter_mutex);
+    for(i=0; i<gm_filter_num; i++)
+    {
+        MAT_WRITE_BUF( "%d ", gm_filter_tgids[i]);
+    }
+    mutex_unlock(&gm_filter_mutex);
+    MAT_WRITE_BUF( "\n");
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_tgids_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * tgids (process ids) separated by spaces, commas or newlines,
+     * at most MAT_FILTER_TGIDS. no tgids (e.g., "\n") removes them.
+     */
+    pid_t tgids[MAT_FILTER_TGIDS];
+    struct mat_task_filter* filter;
+    char* args;
+    char* cursor;
+    char* token;
+    u32 num, unique, i;
+    int rval;
+
+    args = kstrndup(buf, count, GFP_KERNEL);
+    if(!args)
+    {
+        return -ENOMEM;
+    }
+    num = 0;
+    cursor = args;
+    while((token = strsep(&cursor, " ,\n")) != NULL)
+    {
+        if(*token == '\0')
+        {
+            continue;
+        }
+        if(num >= MAT_FILTER_TGIDS || kstrtoint(token, 10, &tgids[num]) || tgids[num] <= 0)
+        {
+            MAT_MERR_FUNC( "invalid tgid %s (#%d)", token, num );
+            kfree(args);
+            return -EINVAL;
+        }
+        num++;
+    }
+    kfree(args);
+    MAT_MDBG_FUNC( "count=%ld num=%d", count, num );
+
+    /* kernel searches sorted tgids */
+    sort(tgids, num, sizeof(pid_t), cmp_pid, NULL);
+    /* skip duplicates */
+    for(i=0, unique=0; i<num; i++)
+    {
+        if(unique == 0 || tgids[unique-1] != tgids[i])
+        {
+            tgids[unique++] = tgids[i];
+        }
+    }
+
+    mutex_lock(&gm_filter_mutex);
+    rval = task_filter_create(tgids, unique, gm_filter_children, gm_filter_cgrp, &filter);
+    if(rval < 0)
+    {
+        mutex_unlock(&gm_filter_mutex);
+        return rval;
+    }
+    task_filter_publish(filter);
+    memcpy(gm_filter_tgids, tgids, unique * sizeof(pid_t));
+    gm_filter_num = unique;
+    mutex_unlock(&gm_filter_mutex);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_tgids, S_IRUSR | S_IWUSR, dev_attr_filter_tgids_show, dev_attr_filter_tgids_store);
+
+static ssize_t dev_attr_filter_children_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gm_filter_children);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_children_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* 1: tasks match if the tgid of an ancestor matches */
+    struct mat_task_filter* filter;
+    int tmp;
+    int rval;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+
+    mutex_lock(&gm_filter_mutex);
+    rval = task_filter_create(gm_filter_tgids, gm_filter_num, tmp, gm_filter_cgrp, &filter);
+    if(rval < 0)
+    {
+        mutex_unlock(&gm_filter_mutex);
+        return rval;
+    }
+    task_filter_publish(filter);
+    gm_filter_children = tmp;
+    mutex_unlock(&gm_filter_mutex);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_children, S_IRUSR | S_IWUSR, dev_attr_filter_children_show, dev_attr_filter_children_store);
+
+static ssize_t dev_attr_filter_cgroup_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    mutex_lock(&gm_filter_mutex);
+    MAT_WRITE_BUF( "%s\n", gm_filter_cgroup_path);
+    mutex_unlock(&gm_filter_mutex);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_cgroup_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * path of cgroup (v2) relative to root of cgroup2 file system,
+     * e.g., "/system.slice/db.service". empty path removes cgroup.
+     */
+    char tmp[sizeof(gm_filter_cgroup_path)];
+    struct mat_task_filter* filter;
+    struct cgroup* cgrp = NULL;
+    char* path;
+    int rval;
+
+    if(count >= sizeof(tmp))
+    {
+        return -EINVAL;
+    }
+    strlcpy(tmp, buf, sizeof(tmp));
+    path = strim(tmp);
+    if(path[0] != '\0')
+    {
+        cgrp = cgroup_get_from_path(path);
+        if(IS_ERR(cgrp))
+        {
+            MAT_MERR_FUNC( "cgroup %s not found", path );
+            return PTR_ERR(cgrp);
+        }
+    }
+    MAT_MDBG_FUNC( "count=%ld path=%s cgrp=%px", count, path, cgrp );
+
+    mutex_lock(&gm_filter_mutex);
+    rval = task_filter_create(gm_filter_tgids, gm_filter_num, gm_filter_children, cgrp, &filter);
+    if(rval < 0)
+    {
+        mutex_unlock(&gm_filter_mutex);
+        if(cgrp)
+        {
+            cgroup_put(cgrp);
+        }
+        return rval;
+    }
+    task_filter_publish(filter);
+    /* module state holds the reference of cgroup_get_from_path */
+    if(gm_filter_cgrp)
+    {
+        cgroup_put(gm_filter_cgrp);
+    }
+    gm_filter_cgrp = cgrp;
+    strlcpy(gm_filter_cgroup_path, path, sizeof(gm_filter_cgroup_path));
+    mutex_unlock(&gm_filter_mutex);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_cgroup, S_IRUSR | S_IWUSR, dev_attr_filter_cgroup_show, dev_attr_filter_cgroup_store);
+#endif /* MAT_FILTER_TASK */
+
+
+
+#ifdef MAT_FILTER_ADDR
+static void addr_filter_destroy(struct mat_addr_filter* filter)
+{
+    if(filter)
+    {
+        free_percpu(filter->cnts);
+        kfree(filter);
+    }
+}
+
+
+
+/*
+ * replace address filter of the kernel by @filter (NULL: no filter)
+ * and free previous filter after readers finished.
+ * called with @gm_filter_mutex held.
+ */
+static void addr_filter_publish(struct mat_addr_filter* filter)
+{
+    struct mat_addr_filter* old;
+
+    old = rcu_dereference_protected(gk_mat_addr_filter, lockdep_is_held(&gm_filter_mutex));
+    rcu_assign_pointer(gk_mat_addr_filter, filter);
+    /* producer (NMI) may still use @old */
+    synchronize_rcu();
+    addr_filter_destroy(old);
+}
+
+
+
+static ssize_t dev_attr_filter_addr_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* one interval per line: start end ratio */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    const struct mat_addr_filter* filter;
+    u32 i;
+
+    mutex_lock(&gm_filter_mutex);
+    filter = rcu_dereference_protected(gk_mat_addr_filter, lockdep_is_held(&gm_filter_mutex));
+    for(i=0; filter && i<filter->num; i++)
+    {
+        MAT_WRITE_BUF( "0x%llx 0x%llx %u\n", filter->starts[i], filter->ends[i], filter->ratios[i]);
+    }
+    mutex_unlock(&gm_filter_mutex);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_addr_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * one interval per line: "start end ratio" with start < end (end
+     * excluded) and ratio 0 (drop all), 1 (keep all) or N (keep 1 in N).
+     * intervals must not overlap, at most MAT_FILTER_INTERVALS.
+     * samples outside of all intervals are kept. no intervals removes filter.
+     */
+    struct mat_addr_filter* filter;
+    char* args;
+    char* cursor;
+    char* line;
+    u64 start, end;
+    u32 ratio;
+    u32 i;
+
+    filter = kzalloc(sizeof(struct mat_addr_filter), GFP_KERNEL);
+    args = kstrndup(buf, count, GFP_KERNEL);
+    if(!filter || !args)
+    {
+        MAT_MERR_FUNC( "failed kzalloc" );
+        kfree(filter); kfree(args);
+        return -ENOMEM;
+    }
+    cursor = args;
+    while((line = strsep(&cursor, "\n")) != NULL)
+    {
+        line = strim(line);
+        if(*line == '\0')
+        {
+            continue;
+        }
+        if(filter->num >= MAT_FILTER_INTERVALS || sscanf(line, "%lli %lli %u", &start, &end, &ratio) != 3 || start >= end)
+        {
+            MAT_MERR_FUNC( "invalid interval %s (#%d)", line, filter->num );
+            goto invalid;
+        }
+        /* insertion sort by start */
+        for(i=filter->num; i>0 && filter->starts[i-1] > start; i--)
+        {
+            filter->starts[i] = filter->starts[i-1];
+            filter->ends[i]   = filter->ends[i-1];
+            filter->ratios[i] = filter->ratios[i-1];
+        }
+        filter->starts[i] = start;
+        filter->ends[i]   = end;
+        filter->ratios[i] = ratio;
+        filter->num++;
+    }
+    kfree(args);
+    for(i=1; i<filter->num; i++)
+    {
+        if(filter->ends[i-1] > filter->starts[i])
+        {
+            MAT_MERR_FUNC( "intervals #%d and #%d overlap", i-1, i );
+            kfree(filter);
+            return -EINVAL;
+        }
+    }
+    MAT_MDBG_FUNC( "count=%ld num=%d", count, filter->num );
+
+    if(filter->num == 0)
+    {
+        kfree(filter);
+        filter = NULL;
+    }
+    else
+    {
+        /* lookup searches all starts, unused ones never match */
+        for(i=filter->num; i<MAT_FILTER_INTERVALS; i++)
+        {
+            filter->starts[i] = U64_MAX;
+        }
+        filter->cnts = __alloc_percpu(MAT_FILTER_INTERVALS * sizeof(u32), sizeof(u32));
+        if(!filter->cnts)
+        {
+            MAT_MERR_FUNC( "failed alloc_percpu" );
+            kfree(filter);
+            return -ENOMEM;
+        }
+    }
+
+    mutex_lock(&gm_filter_mutex);
+    addr_filter_publish(filter);
+    mutex_unlock(&gm_filter_mutex);
+    return count;
+
+invalid:
+    kfree(args);
+    kfree(filter);
+    return -EINVAL;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_addr, S_IRUSR | S_IWUSR, dev_attr_filter_addr_show, dev_attr_filter_addr_store);
+#endif /* MAT_FILTER_ADDR */
+
+
+
+#ifdef MAT_FILTER_MEM
+static const char* const gm_mem_level_names[MAT_FILTER_MEM_NUM] = {
+    [MAT_FILTER_MEM_ALL]    = "all",
+    [MAT_FILTER_MEM_L3MISS] = "l3miss",
+    [MAT_FILTER_MEM_REMOTE] = "remote",
+};
+static ssize_t dev_attr_filter_mem_level_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* list all levels, mark selected one with brackets */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    int level;
+    for(level=0; level<MAT_FILTER_MEM_NUM; level++)
+    {
+        if(level == gk_mat_filter_mem_level)
+        {
+            MAT_WRITE_BUF( "[%s] ", gm_mem_level_names[level]);
+        }
+        else
+        {
+            MAT_WRITE_BUF( "%s ", gm_mem_level_names[level]);
+        }
+    }
+    MAT_WRITE_BUF( "\n");
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_mem_level_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * accept name or number of level, levels other than "all"
+     * need PERF_SAMPLE_DATA_SRC (e.g., perf mem record)
+     */
+    int level;
+
+    for(level=0; level<MAT_FILTER_MEM_NUM; level++)
+    {
+        if(sysfs_streq(buf, gm_mem_level_names[level]))
+        {
+            break;
+        }
+    }
+    if(level == MAT_FILTER_MEM_NUM && (sscanf(buf, "%d", &level) != 1 || level < 0 || level >= MAT_FILTER_MEM_NUM))
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld level=%d", count, level );
+    gk_mat_filter_mem_level = level;
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_mem_level, S_IRUSR | S_IWUSR, dev_attr_filter_mem_level_show, dev_attr_filter_mem_level_store);
+
+static ssize_t dev_attr_filter_mem_weight_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%lld\n", gk_mat_filter_mem_weight);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_mem_weight_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * minimum latency in cycles, 0 keeps all loads.
+     * needs PERF_SAMPLE_WEIGHT (e.g., perf record --weight)
+     */
+    u64 tmp;
+
+    if(kstrtoull(buf, 0, &tmp))
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%lld", count, tmp );
+    gk_mat_filter_mem_weight = tmp;
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_mem_weight, S_IRUSR | S_IWUSR, dev_attr_filter_mem_weight_show, dev_attr_filter_mem_weight_store);
+#endif /* MAT_FILTER_MEM */
+
+
+
+#if defined(MAT_FILTER_TASK) || defined(MAT_FILTER_ADDR) || defined(MAT_FILTER_MEM)
+static ssize_t dev_attr_filter_rejected_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* #samples rejected by filters per core and in total */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    struct mat_filter_cnts total;
+    int cpu;
+
+    memset(&total, 0, sizeof(total));
+    for_each_possible_cpu(cpu)
+    {
+        const struct mat_filter_cnts* cnts = per_cpu_ptr(&cpu_mat_filter_cnts, cpu);
+        if(cpumask_test_cpu(cpu, &gm_cpus_selected))
+        {
+            MAT_WRITE_BUF("CPU %2d: task=%lld addr=%lld mem=%lld\n", cpu, cnts->task, cnts->addr, cnts->mem);
+        }
+        total.task += cnts->task;
+        total.addr += cnts->addr;
+        total.mem  += cnts->mem;
+    }
+    MAT_WRITE_BUF("total: task=%lld addr=%lld mem=%lld\n", total.task, total.addr, total.mem);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_filter_rejected_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int tmp;
+    int cpu;
+
+    tmp = 1;
+    sscanf(buf, "%d", &tmp);
+    /* if 0, reset counters of each core */
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    for_each_possible_cpu(cpu)
+    {
+        memset(per_cpu_ptr(&cpu_mat_filter_cnts, cpu), 0, sizeof(struct mat_filter_cnts));
+    }
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(filter_rejected, S_IRUSR | S_IWUSR, dev_attr_filter_rejected_show, dev_attr_filter_rejected_store);
+
+
+
+/*
+ * setup device attributes for managing filters
+ */
+int filter_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_filter_rejected);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_rejected.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_rejected.attr.name );
+
+#ifdef MAT_FILTER_TASK
+    rval = device_create_file(gm_device, &dev_attr_filter_tgids);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_tgids.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_tgids.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_filter_children);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_children.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_children.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_filter_cgroup);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_cgroup.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_cgroup.attr.name );
+#endif /* MAT_FILTER_TASK */
+
+#ifdef MAT_FILTER_ADDR
+    rval = device_create_file(gm_device, &dev_attr_filter_addr);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_addr.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_addr.attr.name );
+#endif /* MAT_FILTER_ADDR */
+
+#ifdef MAT_FILTER_MEM
+    rval = device_create_file(gm_device, &dev_attr_filter_mem_level);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_mem_level.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_mem_level.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_filter_mem_weight);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_filter_mem_weight.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_filter_mem_weight.attr.name );
+#endif /* MAT_FILTER_MEM */
+    return 0;
+}
+
+
+
+void filter_reset(void)
+{
+    mutex_lock(&gm_filter_mutex);
+#ifdef MAT_FILTER_TASK
+    gm_filter_num = 0;
+    gm_filter_children = false;
+    if(gm_filter_cgrp)
+    {
+        cgroup_put(gm_filter_cgrp);
+    }
+    gm_filter_cgrp = NULL;
+    gm_filter_cgroup_path[0] = '\0';
+    task_filter_publish(NULL);
+#endif /* MAT_FILTER_TASK */
+#ifdef MAT_FILTER_ADDR
+    addr_filter_publish(NULL);
+#endif /* MAT_FILTER_ADDR */
+#ifdef MAT_FILTER_MEM
+    gk_mat_filter_mem_level  = MAT_FILTER_MEM_ALL;
+    gk_mat_filter_mem_weight = 0;
+#endif /* MAT_FILTER_MEM */
+    mutex_unlock(&gm_filter_mutex);
+}
+#endif /* MAT_FILTER_TASK || MAT_FILTER_ADDR || MAT_FILTER_MEM */
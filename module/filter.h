@@ -0,0 +1,11 @@
+#ifndef _MAT_FILTER_H
+#define _MAT_FILTER_H
+
+#include <linux/mat.h>
+
+#if defined(MAT_FILTER_TASK) || defined(MAT_FILTER_ADDR) || defined(MAT_FILTER_MEM)
+int filter_setup_devattr(void);
+void filter_reset(void);
+#endif /* MAT_FILTER_TASK || MAT_FILTER_ADDR || MAT_FILTER_MEM */
+
+#endif /* _MAT_FILTER_H */
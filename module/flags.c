@@ -1,5 +1,6 @@
 #include "flags.h"
 #include <linux/mat.h>
+#include <linux/jiffies.h> /* msecs_to_jiffies, jiffies_to_msecs */
 #include "utilities.h"
 
 
@@ -100,6 +101,76 @@ static DEVICE_ATTR(get_addr, S_IRUSR | S_IWUSR, dev_attr_get_addr_show, dev_attr
 
 
 
+#ifdef MAT_PEBS_BATCH
+static ssize_t dev_attr_pebs_batch_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_pebs_batch);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_pebs_batch_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp == 0 || tmp == 1)
+    {
+        MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+        WRITE_ONCE(gk_mat_pebs_batch, tmp);
+        return count;
+    }
+    else
+    {
+        return -EINVAL;
+    }
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(pebs_batch, S_IRUSR | S_IWUSR, dev_attr_pebs_batch_show, dev_attr_pebs_batch_store);
+
+static ssize_t dev_attr_pebs_batched_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* samples taken from the DS buffer in batches, summed over selected cores (see "cpu") */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    u64 batched = 0;
+    int cpu;
+
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        batched += *per_cpu_ptr(&cpu_mat_pebs_batched, cpu);
+    }
+    MAT_WRITE_BUF( "%lld\n", batched);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_pebs_batched_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": reset counters of every core */
+    int tmp;
+    int cpu;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    for_each_possible_cpu(cpu)
+    {
+        *per_cpu_ptr(&cpu_mat_pebs_batched, cpu) = 0;
+    }
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(pebs_batched, S_IRUSR | S_IWUSR, dev_attr_pebs_batched_show, dev_attr_pebs_batched_store);
+#endif /* MAT_PEBS_BATCH */
+
+
+
 #ifdef MAT_PHYS_ADDR_FLAG
 static ssize_t dev_attr_phys_addr_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
@@ -132,6 +203,87 @@ static DEVICE_ATTR(phys_addr, S_IRUSR | S_IWUSR, dev_attr_phys_addr_show, dev_at
 
 
 
+#ifdef MAT_PHYS_ADDR_CACHE
+static ssize_t dev_attr_phys_cache_age_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* maximum age of cached translations in ms (0: cache disabled) */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", jiffies_to_msecs(gk_mat_phys_cache_age));
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_phys_cache_age_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    unsigned int tmp;
+
+    if(kstrtouint(buf, 0, &tmp))
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%u", count, tmp );
+    /* a non-zero age lasts at least one jiffy */
+    WRITE_ONCE(gk_mat_phys_cache_age, tmp ? max(msecs_to_jiffies(tmp), 1ul) : 0);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(phys_cache_age, S_IRUSR | S_IWUSR, dev_attr_phys_cache_age_show, dev_attr_phys_cache_age_store);
+
+static ssize_t dev_attr_phys_cache_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* hits and misses of translation caches per core and in total */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    u64 total_hits = 0;
+    u64 total_misses = 0;
+    u64 total_flushes = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+    {
+        const struct mat_phys_cache* cache = per_cpu_ptr(&cpu_mat_phys_cache, cpu);
+        if(cpumask_test_cpu(cpu, &gm_cpus_selected) && (cache->hits || cache->misses))
+        {
+            MAT_WRITE_BUF("CPU %2d: hits=%lld misses=%lld flushes=%lld\n", cpu, cache->hits, cache->misses, cache->flushes);
+        }
+        total_hits    += cache->hits;
+        total_misses  += cache->misses;
+        total_flushes += cache->flushes;
+    }
+    MAT_WRITE_BUF("total: hits=%lld misses=%lld flushes=%lld hit_rate=%lld%%\n", total_hits, total_misses, total_flushes,
+        (total_hits + total_misses) ? (total_hits * 100) / (total_hits + total_misses) : 0);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_phys_cache_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": reset counters of every core */
+    int tmp;
+    int cpu;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_phys_cache* cache = per_cpu_ptr(&cpu_mat_phys_cache, cpu);
+        cache->hits    = 0;
+        cache->misses  = 0;
+        cache->flushes = 0;
+    }
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(phys_cache, S_IRUSR | S_IWUSR, dev_attr_phys_cache_show, dev_attr_phys_cache_store);
+#endif /* MAT_PHYS_ADDR_CACHE */
+
+
+
 int flags_setup_devattr(void)
 {
     int rval = 0;
@@ -165,6 +317,24 @@ int flags_setup_devattr(void)
     MAT_MDBG_FUNC( "created %s", dev_attr_get_addr.attr.name );
 #endif /* MAT_GET_ADDR_FLAG */
 
+#ifdef MAT_PEBS_BATCH
+    rval = device_create_file(gm_device, &dev_attr_pebs_batch);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_pebs_batch.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_pebs_batch.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_pebs_batched);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_pebs_batched.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_pebs_batched.attr.name );
+#endif /* MAT_PEBS_BATCH */
+
 #ifdef MAT_PHYS_ADDR_FLAG
     rval = device_create_file(gm_device, &dev_attr_phys_addr);
     if (rval < 0)
@@ -174,6 +344,24 @@ int flags_setup_devattr(void)
     }
     MAT_MDBG_FUNC( "created %s", dev_attr_phys_addr.attr.name );
 #endif /* MAT_PHYS_ADDR_FLAG */
+
+#ifdef MAT_PHYS_ADDR_CACHE
+    rval = device_create_file(gm_device, &dev_attr_phys_cache_age);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_phys_cache_age.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_phys_cache_age.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_phys_cache);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_phys_cache.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_phys_cache.attr.name );
+#endif /* MAT_PHYS_ADDR_CACHE */
     return rval;
 }
 
@@ -190,8 +378,14 @@ void flags_reset(void)
 #ifdef MAT_GET_ADDR_FLAG
     gk_mat_get_addr = 0;
 #endif /* MAT_GET_ADDR_FLAG */
+#ifdef MAT_PEBS_BATCH
+    gk_mat_pebs_batch = 0;
+#endif /* MAT_PEBS_BATCH */
 #ifdef MAT_PHYS_ADDR_FLAG
     gk_mat_phys_addr = 0;
 #endif /* MAT_PHYS_ADDR_FLAG */
+#ifdef MAT_PHYS_ADDR_CACHE
+    gk_mat_phys_cache_age = max(msecs_to_jiffies(10), 1ul);
+#endif /* MAT_PHYS_ADDR_CACHE */
 }
 
@@ -0,0 +1,362 @@
+#include "hashtable.h"
+
+#include <linux/slab.h>    /* vzalloc, vfree */
+#include <linux/vmalloc.h> /* vzalloc */
+#include <linux/device.h>  /* device (attriutes) */
+#include <linux/uio.h>     /* copy_to_iter */
+#include <linux/cpumask.h> /* nr_cpu_ids, num_online_cpus */
+#include <linux/rwsem.h>   /* down/up_read/write */
+#include <linux/log2.h>    /* roundup_pow_of_two, ilog2 */
+#include <linux/rcupdate.h> /* synchronize_rcu */
+
+#include "utilities.h"
+
+#ifdef MAT_ADDR_HASH_TABLE
+/*
+ * readers of hash tables hold the lock for reading,
+ * creating and deleting hash tables holds the lock for writing,
+ * so does enabling hash tables. producers (NMIs) check
+ * gk_mat_hash_enabled, tables are changed only after a grace period
+ * following disabling.
+ */
+static DECLARE_RWSEM(gm_hashtable_rwsem);
+/* key of a sample is address >> @gm_hash_shift (default: 4 KiB pages) */
+static u32 gm_hash_shift = 12;
+
+
+
+static void clear_table(struct mat_hash_table* table)
+{
+    table->samples   = 0;
+    table->used      = 0;
+    table->evictions = 0;
+    table->evicted   = 0;
+    table->shift     = gm_hash_shift;
+    if(table->entries)
+    {
+        memset(table->entries, 0, table->capacity * sizeof(struct mat_hash_entry));
+    }
+}
+
+
+
+static u64 create_table(struct mat_hash_table* table, u64 capacity)
+{
+    table->entries  = NULL;
+    table->capacity = 0;
+    table->bits     = 0;
+    clear_table(table);
+
+    table->entries = (struct mat_hash_entry*) vzalloc( capacity * sizeof(struct mat_hash_entry) );
+    if(!table->entries)
+    {
+        MAT_MERR_FUNC( "failed vzalloc %lld entries", capacity );
+        return 0;
+    }
+    MAT_MDBG_FUNC( "vzalloc %lld entries", capacity );
+    table->capacity = capacity;
+    table->bits     = ilog2(capacity);
+
+    return capacity;
+}
+
+
+
+static void destoy_table(struct mat_hash_table* table)
+{
+    if(table && table->entries)
+    {
+        table->capacity = 0;
+        table->bits     = 0;
+        MAT_MDBG_FUNC( "vfree table->entries=%px", table->entries );
+        vfree( table->entries );
+        table->entries  = NULL;
+    }
+    clear_table(table);
+}
+
+
+
+static void destoy_alltables(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_hash_table* table = per_cpu_ptr(&cpu_mat_hash_tables, cpu);
+        destoy_table( table );
+    }
+}
+
+
+
+/*
+ * device attribute functions for managing per-core hash tables
+ */
+static ssize_t dev_attr_hash_enabled_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_hash_enabled);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_hash_enabled_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    /* not while tables are replaced or cleared */
+    down_write(&gm_hashtable_rwsem);
+    WRITE_ONCE(gk_mat_hash_enabled, tmp);
+    up_write(&gm_hashtable_rwsem);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(hash_enabled, S_IRUSR | S_IWUSR, dev_attr_hash_enabled_show, dev_attr_hash_enabled_store);
+
+static ssize_t dev_attr_hash_table_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* one line per core and a summary of all cores */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    u64 total_capacity = 0;
+    u64 total_samples = 0;
+    u64 total_evicted = 0;
+    int cpu;
+    MAT_MDBG_FUNC();
+
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        struct mat_hash_table* table = per_cpu_ptr(&cpu_mat_hash_tables, cpu);
+        if(!cpumask_test_cpu(cpu, &gm_cpumask))
+        {
+            continue;
+        }
+        MAT_WRITE_BUF("CPU %2d: capacity=%lld (%lld MiB) used=%lld samples=%lld evictions=%lld evicted=%lld\n",
+            cpu, table->capacity, (table->capacity*sizeof(struct mat_hash_entry))/(1024*1024), table->used,
+            table->samples, table->evictions, table->evicted);
+        total_capacity += table->capacity;
+        total_samples  += table->samples;
+        total_evicted  += table->evicted;
+    }
+    MAT_WRITE_BUF("shift:          %16d\n", gm_hash_shift);
+    MAT_WRITE_BUF("total_capacity: %16lld (%10lld MiB)\n", total_capacity, (total_capacity*sizeof(struct mat_hash_entry) / (1024*1024)));
+    MAT_WRITE_BUF("total_samples:  %16lld\n", total_samples);
+    MAT_WRITE_BUF("total_evicted:  %16lld\n", total_evicted);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t hash_table_store(const char *buf, size_t count)
+{
+    /*
+     * "0": delete hash tables of every core
+     * "N": allocate hash tables with (at least) N entries on every traced core,
+     *      N is rounded up to a power of 2
+     */
+    const int CPUS = cpumask_weight(&gm_cpumask);
+    s64 arg;
+    u64 capacity;
+    int cpu;
+
+    arg = -1;
+    sscanf(buf, "%lld", &arg);
+    MAT_MDBG_FUNC( "count=%ld arg=%lld", count, arg );
+    if(arg < 0)
+    {
+        return -EINVAL;
+    }
+
+    destoy_alltables();
+    if(arg == 0)
+    {
+        return count;
+    }
+
+    capacity = roundup_pow_of_two(max_t(u64, arg, MAT_HASH_PROBES));
+    if(capacity * sizeof(struct mat_hash_entry) * CPUS > HASH_TABLE_LIMIT) // limit total size
+    {
+        MAT_MERR_FUNC( "total hash table too large" );
+        return -EINVAL;
+    }
+    for_each_cpu(cpu, &gm_cpumask)
+    {
+        struct mat_hash_table* table = per_cpu_ptr(&cpu_mat_hash_tables, cpu);
+        if( !create_table(table, capacity) )
+        {
+            MAT_MERR_FUNC( "failed create_table(%px, %lld)", table, capacity );
+            destoy_alltables();
+            return -ENOMEM;
+        }
+    }
+    return count;
+}
+static ssize_t dev_attr_hash_table_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    ssize_t rval;
+
+    /* wait for readers of hash tables to finish */
+    down_write(&gm_hashtable_rwsem);
+    /* producer must not use tables while they are replaced */
+    if(gk_mat_hash_enabled)
+    {
+        up_write(&gm_hashtable_rwsem);
+        MAT_MERR_FUNC( "disable hash tables before changing them" );
+        return -EBUSY;
+    }
+    /* producers (NMIs) may still insert into tables */
+    synchronize_rcu();
+    rval = hash_table_store(buf, count);
+    up_write(&gm_hashtable_rwsem);
+    return rval;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(hash_table, S_IRUSR | S_IWUSR, dev_attr_hash_table_show, dev_attr_hash_table_store);
+
+static ssize_t dev_attr_hash_shift_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gm_hash_shift);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_hash_shift_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* e.g., 6 for cache lines, 12 for 4 KiB pages */
+    int tmp;
+    int cpu;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp < 0 || tmp > 63)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+
+    /* keys change meaning, counted samples are dropped */
+    down_write(&gm_hashtable_rwsem);
+    if(gk_mat_hash_enabled)
+    {
+        up_write(&gm_hashtable_rwsem);
+        MAT_MERR_FUNC( "disable hash tables before changing shift" );
+        return -EBUSY;
+    }
+    /* producers (NMIs) may still insert into tables */
+    synchronize_rcu();
+    gm_hash_shift = tmp;
+    for_each_possible_cpu(cpu)
+    {
+        clear_table( per_cpu_ptr(&cpu_mat_hash_tables, cpu) );
+    }
+    up_write(&gm_hashtable_rwsem);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(hash_shift, S_IRUSR | S_IWUSR, dev_attr_hash_shift_show, dev_attr_hash_shift_store);
+
+
+
+/*
+ * setup device attributes for managing per-core hash tables
+ */
+int hashtable_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_hash_enabled);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_hash_enabled.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_hash_enabled.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_hash_table);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_hash_table.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_hash_table.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_hash_shift);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_hash_shift.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_hash_shift.attr.name );
+    return 0;
+}
+
+
+
+void hashtable_reset(void)
+{
+    down_write(&gm_hashtable_rwsem);
+    WRITE_ONCE(gk_mat_hash_enabled, 0);
+    /* producers (NMIs) may still insert into tables */
+    synchronize_rcu();
+    destoy_alltables();
+    up_write(&gm_hashtable_rwsem);
+}
+
+
+
+ssize_t hashtable_read(int cpu, struct iov_iter *to, loff_t *off)
+{
+    /*
+     * read hash table of core with id @cpu as array of
+     * struct mat_hash_entry (u64 key, u64 count) pairs.
+     * entries with count 0 are empty. the offset @off refers to
+     * the bytes of the array, i.e., the table is seekable.
+     */
+    size_t len = iov_iter_count(to);
+    struct mat_hash_table* table;
+    ssize_t result;
+    u64 bytes;
+
+    /* make sure that selected CPU @cpu is valid */
+    if(!utilities_cpu_valid(cpu))
+    {
+        MAT_MERR_FUNC( "cpu=%d", cpu );
+        return -EFAULT;
+    }
+
+    down_read(&gm_hashtable_rwsem);
+    table = per_cpu_ptr(&cpu_mat_hash_tables, cpu);
+    if(!table->entries)
+    {
+        result = -ENODATA; goto exit;
+    }
+    bytes = table->capacity * sizeof(struct mat_hash_entry);
+    /* end of table reached */
+    if(*off >= bytes)
+    {
+        result = 0; goto exit;
+    }
+    if(len > bytes - *off)
+    {
+        len = bytes - *off;
+    }
+    len = copy_to_iter((char*)table->entries + *off, len, to);
+    if(!len)
+    {
+        MAT_MERR_FUNC( "len=%ld off=%lld", iov_iter_count(to), *off );
+        result = -EFAULT; goto exit;
+    }
+    *off  += len;
+    result = len;
+    MAT_MDBG_FUNC( "cpu=%d len=%ld off=%lld", cpu, len, *off );
+exit:
+    up_read(&gm_hashtable_rwsem);
+    return result;
+}
+#endif /* MAT_ADDR_HASH_TABLE */
@@ -0,0 +1,15 @@
+#ifndef _MAT_HASHTABLE_H
+#define _MAT_HASHTABLE_H
+
+#include <linux/mat.h>
+#include <linux/uio.h> /* iov_iter */
+
+#define HASH_TABLE_LIMIT (0x1000000000ull) /* let size of all CPU hash tables not exceed 64 GiB */
+
+#ifdef MAT_ADDR_HASH_TABLE
+int hashtable_setup_devattr(void);
+void hashtable_reset(void);
+ssize_t hashtable_read(int cpu, struct iov_iter *to, loff_t *off);
+#endif /* MAT_ADDR_HASH_TABLE */
+
+#endif /* _MAT_HASHTABLE_H */
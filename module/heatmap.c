@@ -0,0 +1,637 @@
+#include "heatmap.h"
+
+#include <linux/device.h>      /* device (attriutes) */
+#include <linux/sysfs.h>       /* bin_attribute */
+#include <linux/cpumask.h>     /* nr_cpu_ids, for_each_cpu */
+#include <linux/topology.h>    /* cpu_to_node */
+#include <linux/slab.h>        /* kzalloc, kfree */
+#include <linux/vmalloc.h>     /* vzalloc_node, vfree */
+#include <linux/mutex.h>       /* mutex_lock/unlock */
+#include <linux/hrtimer.h>     /* hrtimer */
+#include <linux/ktime.h>       /* ms_to_ktime */
+#include <linux/timekeeping.h> /* ktime_get_ns */
+#include <linux/rcupdate.h>    /* synchronize_rcu */
+
+#include "utilities.h"
+
+#ifdef MAT_ADDR_HEATMAP
+/* counters of a heatmap are limited to 1 GiB per core */
+#define HEATMAP_MAX_CELLS (1u << 28)
+
+/*
+ * protects configuration and @gm_heatmap, i.e., starting, stopping,
+ * reading and freeing. the timer advancing columns does not take it.
+ */
+static DEFINE_MUTEX(gm_heatmap_mutex);
+/* configuration of the next heatmap, @gm_heatmap_rows is the maximum number of rows */
+static u64 gm_heatmap_min   = 0;
+static u64 gm_heatmap_max   = 1ull << 47;
+static u32 gm_heatmap_scale = MAT_HEATMAP_LINEAR;
+static u32 gm_heatmap_rows  = 1024;
+static u32 gm_heatmap_cols  = 3600;
+static u32 gm_heatmap_ms    = 1000;
+/* last heatmap (published in gk_mat_heatmap while running) and begin of column 0 */
+static struct mat_heatmap* gm_heatmap = NULL;
+static u64 gm_heatmap_start = 0;
+static bool gm_heatmap_running = false;
+/* advances column of @gm_heatmap every @gm_heatmap_ms ms */
+static struct hrtimer gm_heatmap_timer;
+
+
+
+/*
+ * smallest shift (linear) or largest shift (log) of rows such that the
+ * rows of [@gm_heatmap_min, @gm_heatmap_max) fit into @gm_heatmap_rows.
+ * returns number of rows or 0 if they do not fit.
+ */
+static u32 heatmap_rows(u32* shift)
+{
+    const u64 last = gm_heatmap_max - gm_heatmap_min - 1;
+    u32 s = 0;
+
+    if(gm_heatmap_scale == MAT_HEATMAP_LINEAR)
+    {
+        while((last >> s) >= gm_heatmap_rows)
+        {
+            s++;
+        }
+    }
+    else
+    {
+        /* log rows with shift 0 are powers of two, finer rows need more of them */
+        while(s < 16 && mat_heatmap_row(MAT_HEATMAP_LOG, s + 1, last) < gm_heatmap_rows)
+        {
+            s++;
+        }
+        if(mat_heatmap_row(MAT_HEATMAP_LOG, s, last) >= gm_heatmap_rows)
+        {
+            return 0;
+        }
+    }
+    *shift = s;
+    return mat_heatmap_row(gm_heatmap_scale, s, last) + 1;
+}
+
+
+
+static u64 heatmap_cpu_bytes(const struct mat_heatmap* map)
+{
+    return sizeof(struct mat_heatmap_cpu) + (u64)map->rows * map->cols * sizeof(u32);
+}
+
+
+
+/* free @gm_heatmap, producers must be stopped; holds @gm_heatmap_mutex */
+static void heatmap_destroy(void)
+{
+    int cpu;
+
+    if(!gm_heatmap)
+    {
+        return;
+    }
+    for_each_possible_cpu(cpu)
+    {
+        vfree(gm_heatmap->cpus[cpu]);
+    }
+    kfree(gm_heatmap);
+    gm_heatmap = NULL;
+}
+
+
+
+/* allocate @gm_heatmap with counters of traced cores (on node of core); holds @gm_heatmap_mutex */
+static int heatmap_create(void)
+{
+    struct mat_heatmap* map;
+    u32 shift = 0;
+    u32 rows;
+    int cpu;
+
+    rows = heatmap_rows(&shift);
+    if(!rows || (u64)rows * gm_heatmap_cols > HEATMAP_MAX_CELLS)
+    {
+        MAT_MERR_FUNC( "rows=%u (at most %u) cols=%u", rows, gm_heatmap_rows, gm_heatmap_cols );
+        return -EINVAL;
+    }
+    map = kzalloc(sizeof(struct mat_heatmap) + nr_cpu_ids * sizeof(struct mat_heatmap_cpu*), GFP_KERNEL);
+    if(!map)
+    {
+        MAT_MERR_FUNC( "failed kzalloc" );
+        return -ENOMEM;
+    }
+    map->min   = gm_heatmap_min;
+    map->max   = gm_heatmap_max;
+    map->scale = gm_heatmap_scale;
+    map->shift = shift;
+    map->rows  = rows;
+    map->cols  = gm_heatmap_cols;
+    map->col   = 0;
+    gm_heatmap = map;
+    for_each_cpu(cpu, &gm_cpumask)
+    {
+        map->cpus[cpu] = vzalloc_node(heatmap_cpu_bytes(map), cpu_to_node(cpu));
+        if(!map->cpus[cpu])
+        {
+            MAT_MERR_FUNC( "failed to allocate %lld bytes for cpu=%d", heatmap_cpu_bytes(map), cpu );
+            heatmap_destroy();
+            return -ENOMEM;
+        }
+        map->cpus[cpu]->cpu = cpu;
+    }
+    MAT_MDBG_FUNC( "rows=%u shift=%u cols=%u: %lld bytes per core", rows, shift, map->cols, heatmap_cpu_bytes(map) );
+    return 0;
+}
+
+
+
+static enum hrtimer_restart heatmap_timer_func(struct hrtimer *timer)
+{
+    /* a late timer skips columns, so a column always stands for the same time */
+    const u64 overruns = hrtimer_forward_now(timer, ms_to_ktime(gm_heatmap_ms));
+    const u32 col = min_t(u64, gm_heatmap->col + overruns, gm_heatmap->cols);
+
+    WRITE_ONCE(gm_heatmap->col, col);
+    return (col < gm_heatmap->cols) ? HRTIMER_RESTART : HRTIMER_NORESTART;
+}
+
+
+
+/* start new heatmap in column 0; holds @gm_heatmap_mutex */
+static int heatmap_start(void)
+{
+    int rval;
+
+    if(gm_heatmap_running)
+    {
+        return 0;
+    }
+    heatmap_destroy();
+    rval = heatmap_create();
+    if(rval < 0)
+    {
+        return rval;
+    }
+    gm_heatmap_start   = ktime_get_ns();
+    gm_heatmap_running = true;
+    rcu_assign_pointer(gk_mat_heatmap, gm_heatmap);
+    hrtimer_start(&gm_heatmap_timer, ms_to_ktime(gm_heatmap_ms), HRTIMER_MODE_REL);
+    return 0;
+}
+
+
+
+/* stop producers and columns, counters stay readable; holds @gm_heatmap_mutex */
+static void heatmap_stop(void)
+{
+    if(!gm_heatmap_running)
+    {
+        return;
+    }
+    gm_heatmap_running = false;
+    rcu_assign_pointer(gk_mat_heatmap, NULL);
+    hrtimer_cancel(&gm_heatmap_timer);
+    /* producers (NMIs) may still count in @gm_heatmap */
+    synchronize_rcu();
+}
+
+
+
+/* columns that have started (at most @cols) */
+static u32 heatmap_cols_used(const struct mat_heatmap* map)
+{
+    return min(READ_ONCE(map->col) + 1, map->cols);
+}
+
+
+
+/* store u32 in [@min, @max] to @value unless heatmap is running */
+static ssize_t heatmap_store_u32(const char *buf, size_t count, u32* value, u32 min, u32 max)
+{
+    unsigned int tmp;
+    ssize_t rval = count;
+
+    if(kstrtouint(buf, 0, &tmp) || tmp < min || tmp > max)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%u", count, tmp );
+    mutex_lock(&gm_heatmap_mutex);
+    if(gm_heatmap_running)
+    {
+        MAT_MERR_FUNC( "disable heatmap before changing it" );
+        rval = -EBUSY;
+    }
+    else
+    {
+        *value = tmp;
+    }
+    mutex_unlock(&gm_heatmap_mutex);
+    return rval;
+}
+
+
+
+/*
+ * device attribute functions for managing per-core heatmaps
+ */
+static ssize_t dev_attr_heatmap_enabled_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gm_heatmap_running);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_enabled_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * "1": allocate heatmap of traced cores and start in column 0
+     * "0": stop, heatmap stays readable
+     */
+    int rval = 0;
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    mutex_lock(&gm_heatmap_mutex);
+    if(tmp)
+    {
+        rval = heatmap_start();
+    }
+    else
+    {
+        heatmap_stop();
+    }
+    mutex_unlock(&gm_heatmap_mutex);
+    return (rval < 0) ? rval : count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap_enabled, S_IRUSR | S_IWUSR, dev_attr_heatmap_enabled_show, dev_attr_heatmap_enabled_store);
+
+static ssize_t dev_attr_heatmap_range_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "0x%llx 0x%llx\n", gm_heatmap_min, gm_heatmap_max);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_range_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "<min> <max>": rows cover addresses in [min, max) */
+    u64 min;
+    u64 max;
+    ssize_t rval = count;
+
+    if(sscanf(buf, "%lli %lli", &min, &max) != 2 || min >= max)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld min=0x%llx max=0x%llx", count, min, max );
+    mutex_lock(&gm_heatmap_mutex);
+    if(gm_heatmap_running)
+    {
+        MAT_MERR_FUNC( "disable heatmap before changing it" );
+        rval = -EBUSY;
+    }
+    else
+    {
+        gm_heatmap_min = min;
+        gm_heatmap_max = max;
+    }
+    mutex_unlock(&gm_heatmap_mutex);
+    return rval;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap_range, S_IRUSR | S_IWUSR, dev_attr_heatmap_range_show, dev_attr_heatmap_range_store);
+
+static ssize_t dev_attr_heatmap_scale_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%s\n", (gm_heatmap_scale == MAT_HEATMAP_LOG) ? "log" : "linear");
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_scale_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "linear": rows of equal size, "log": rows grow with distance to min */
+    u32 scale;
+    ssize_t rval = count;
+
+    if(sysfs_streq(buf, "linear"))
+    {
+        scale = MAT_HEATMAP_LINEAR;
+    }
+    else if(sysfs_streq(buf, "log"))
+    {
+        scale = MAT_HEATMAP_LOG;
+    }
+    else
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld scale=%u", count, scale );
+    mutex_lock(&gm_heatmap_mutex);
+    if(gm_heatmap_running)
+    {
+        MAT_MERR_FUNC( "disable heatmap before changing it" );
+        rval = -EBUSY;
+    }
+    else
+    {
+        gm_heatmap_scale = scale;
+    }
+    mutex_unlock(&gm_heatmap_mutex);
+    return rval;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap_scale, S_IRUSR | S_IWUSR, dev_attr_heatmap_scale_show, dev_attr_heatmap_scale_store);
+
+static ssize_t dev_attr_heatmap_rows_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", gm_heatmap_rows);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_rows_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* maximum number of rows, the size of rows is derived from range and scale */
+    return heatmap_store_u32(buf, count, &gm_heatmap_rows, 2, 1 << 16);
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap_rows, S_IRUSR | S_IWUSR, dev_attr_heatmap_rows_show, dev_attr_heatmap_rows_store);
+
+static ssize_t dev_attr_heatmap_cols_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", gm_heatmap_cols);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_cols_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* number of columns (time buckets), samples after the last one are counted as late */
+    return heatmap_store_u32(buf, count, &gm_heatmap_cols, 1, HEATMAP_MAX_CELLS);
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap_cols, S_IRUSR | S_IWUSR, dev_attr_heatmap_cols_show, dev_attr_heatmap_cols_store);
+
+static ssize_t dev_attr_heatmap_ms_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", gm_heatmap_ms);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_ms_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* width of a column (time bucket) in ms */
+    return heatmap_store_u32(buf, count, &gm_heatmap_ms, 1, UINT_MAX);
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap_ms, S_IRUSR | S_IWUSR, dev_attr_heatmap_ms_show, dev_attr_heatmap_ms_store);
+
+static ssize_t dev_attr_heatmap_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* shape of last heatmap and counters of selected cores (see "cpu") */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    const struct mat_heatmap* map;
+    int cpu;
+
+    mutex_lock(&gm_heatmap_mutex);
+    map = gm_heatmap;
+    if(!map)
+    {
+        MAT_WRITE_BUF("heatmap: none\n");
+        goto exit;
+    }
+    MAT_WRITE_BUF("heatmap: range=[0x%llx, 0x%llx) rows=%u (%s, shift=%u) cols=%u/%u (%u ms) bytes/core=%lld\n",
+        map->min, map->max, map->rows, (map->scale == MAT_HEATMAP_LOG) ? "log" : "linear", map->shift,
+        heatmap_cols_used(map), map->cols, gm_heatmap_ms, heatmap_cpu_bytes(map));
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        const struct mat_heatmap_cpu* heat = map->cpus[cpu];
+        const u64 cells = (u64)map->rows * map->cols;
+        u64 samples = 0;
+        u64 i;
+        if(!heat)
+        {
+            continue;
+        }
+        for(i=0; i<cells; i++)
+        {
+            samples += heat->cnts[i];
+        }
+        MAT_WRITE_BUF("CPU %2d: samples=%lld outside=%lld late=%lld\n", cpu, samples, heat->outside, heat->late);
+    }
+exit:
+    mutex_unlock(&gm_heatmap_mutex);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_heatmap_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": stop and free heatmap */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    heatmap_reset();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(heatmap, S_IRUSR | S_IWUSR, dev_attr_heatmap_show, dev_attr_heatmap_store);
+
+
+
+/* header of binary attribute "heatmap_matrix"; holds @gm_heatmap_mutex */
+static void heatmap_header(struct mat_heatmap_header* header, const struct mat_heatmap* map)
+{
+    int cpu;
+
+    memset(header, 0, sizeof(*header));
+    header->magic        = MAT_HEATMAP_MAGIC;
+    header->version      = MAT_HEATMAP_VERSION;
+    header->header_bytes = sizeof(struct mat_heatmap_header);
+    header->min          = map->min;
+    header->max          = map->max;
+    header->scale        = map->scale;
+    header->shift        = map->shift;
+    header->rows         = map->rows;
+    header->cols         = map->cols;
+    header->start        = gm_heatmap_start;
+    header->col_ms       = gm_heatmap_ms;
+    header->cols_used    = heatmap_cols_used(map);
+    header->cpu_bytes    = heatmap_cpu_bytes(map);
+    for_each_possible_cpu(cpu)
+    {
+        header->cpus += (map->cpus[cpu] != NULL);
+    }
+}
+
+
+
+/*
+ * binary attribute with heatmap of every traced core (see struct mat_heatmap_header),
+ * i.e., a single read (e.g., cat) of the whole heatmap.
+ * the file is seekable, a read may start and end within an entry.
+ */
+static ssize_t bin_attr_heatmap_matrix_read(struct file *file, struct kobject *kobj, struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+    const struct mat_heatmap* map;
+    struct mat_heatmap_header header;
+    loff_t end;
+    size_t done = 0;
+    int cpu;
+
+    mutex_lock(&gm_heatmap_mutex);
+    map = gm_heatmap;
+    if(!map)
+    {
+        goto exit;
+    }
+    heatmap_header(&header, map);
+
+    /* header */
+    if(off < sizeof(header))
+    {
+        done = min_t(size_t, sizeof(header) - off, count);
+        memcpy(buf, (char*)&header + off, done);
+    }
+    /* entries of traced cores in order of CPU ids, @end is end of entry */
+    end = sizeof(header);
+    for_each_possible_cpu(cpu)
+    {
+        const loff_t pos = off + done;
+        loff_t begin;
+        size_t len;
+        if(done == count)
+        {
+            break;
+        }
+        if(!map->cpus[cpu])
+        {
+            continue;
+        }
+        end += header.cpu_bytes;
+        if(pos >= end)
+        {
+            continue;
+        }
+        begin = pos - (end - header.cpu_bytes);
+        len   = min_t(u64, header.cpu_bytes - begin, count - done);
+        memcpy(buf + done, (char*)map->cpus[cpu] + begin, len);
+        done += len;
+    }
+exit:
+    mutex_unlock(&gm_heatmap_mutex);
+    MAT_MDBG_FUNC( "off=%lld count=%ld done=%ld", off, count, done );
+    return done;
+}
+/* create binary attribute bin_attr_<name>, size 0: size depends on heatmap */
+static BIN_ATTR(heatmap_matrix, S_IRUSR, bin_attr_heatmap_matrix_read, NULL, 0);
+
+
+
+/*
+ * setup device attributes for managing per-core heatmaps
+ */
+int heatmap_setup_devattr(void)
+{
+    int rval;
+    hrtimer_init(&gm_heatmap_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    gm_heatmap_timer.function = heatmap_timer_func;
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap_enabled);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap_enabled.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap_enabled.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap_range);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap_range.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap_range.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap_scale);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap_scale.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap_scale.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap_rows);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap_rows.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap_rows.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap_cols);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap_cols.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap_cols.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap_ms);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap_ms.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap_ms.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_heatmap);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_heatmap.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_heatmap.attr.name );
+
+    rval = device_create_bin_file(gm_device, &bin_attr_heatmap_matrix);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", bin_attr_heatmap_matrix.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", bin_attr_heatmap_matrix.attr.name );
+    return 0;
+}
+
+
+
+void heatmap_reset(void)
+{
+    mutex_lock(&gm_heatmap_mutex);
+    heatmap_stop();
+    heatmap_destroy();
+    mutex_unlock(&gm_heatmap_mutex);
+}
+#endif /* MAT_ADDR_HEATMAP */
@@ -0,0 +1,42 @@
+#ifndef _MAT_HEATMAP_H
+#define _MAT_HEATMAP_H
+
+#include <linux/mat.h>
+
+#ifdef MAT_ADDR_HEATMAP
+/*
+ * layout of binary attribute "heatmap_matrix": a header followed by one
+ * entry per traced core (struct mat_heatmap_cpu, sorted by @cpu) with
+ * @rows x @cols u32 counters, column after column (time bucket after time
+ * bucket). columns from @cols_used on have not started yet. an entry has
+ * @cpu_bytes bytes. counters are a snapshot without locking, the producer
+ * may update them while they are read.
+ */
+#define MAT_HEATMAP_MAGIC   (0x544145485f54414dull) /* "MAT_HEAT" in little endian */
+#define MAT_HEATMAP_VERSION 1
+struct mat_heatmap_header
+{
+    u64 magic;
+    u32 version;
+    u32 header_bytes;
+    /* address range [@min, @max), rows (see struct mat_heatmap) */
+    u64 min;
+    u64 max;
+    u32 scale;
+    u32 shift;
+    u32 rows;
+    u32 cols;
+    /* begin of column 0 (CLOCK_MONOTONIC, ns) and width of a column */
+    u64 start;
+    u32 col_ms;
+    u32 cols_used;
+    u32 cpus;
+    u32 reserved;
+    u64 cpu_bytes;
+};
+
+int heatmap_setup_devattr(void);
+void heatmap_reset(void);
+#endif /* MAT_ADDR_HEATMAP */
+
+#endif /* _MAT_HEATMAP_H */
@@ -0,0 +1,151 @@
+#include "hist.h"
+
+#include <linux/device.h>  /* device (attriutes) */
+#include <linux/cpumask.h> /* for_each_cpu */
+#include <linux/slab.h>    /* kzalloc, kfree */
+
+#include "utilities.h"
+
+#ifdef MAT_LATENCY_HIST
+static void hist_clear(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_hist* hist = per_cpu_ptr(&cpu_mat_hist, cpu);
+        memset(hist->process, 0, sizeof(hist->process));
+        memset(hist->pmi,     0, sizeof(hist->pmi));
+        memset(hist->batch,   0, sizeof(hist->batch));
+    }
+}
+
+
+
+/*
+ * device attribute functions for managing histograms of the tracing overhead
+ */
+static ssize_t dev_attr_hist_enabled_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_hist_enabled);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_hist_enabled_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    WRITE_ONCE(gk_mat_hist_enabled, tmp);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(hist_enabled, S_IRUSR | S_IWUSR, dev_attr_hist_enabled_show, dev_attr_hist_enabled_store);
+
+static ssize_t dev_attr_hist_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /*
+     * one line per non-empty bucket, summed over selected cores (see "cpu").
+     * bucket i counts values in [2^(i-1), 2^i), bucket 0 counts 0.
+     */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    struct mat_hist* sum;
+    u64 samples = 0;
+    u64 pmis = 0;
+    u32 idx;
+    int cpu;
+
+    sum = kzalloc(sizeof(struct mat_hist), GFP_KERNEL);
+    if(!sum)
+    {
+        return -ENOMEM;
+    }
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        const struct mat_hist* hist = per_cpu_ptr(&cpu_mat_hist, cpu);
+        for(idx=0; idx<MAT_HIST_BUCKETS; idx++)
+        {
+            sum->process[idx] += hist->process[idx];
+            sum->pmi[idx]     += hist->pmi[idx];
+            sum->batch[idx]   += hist->batch[idx];
+        }
+    }
+
+    MAT_WRITE_BUF(" %6s | %20s | %16s | %16s | %16s\n", "bucket", ">= value", "process cycles", "pmi cycles", "samples per pmi");
+    for(idx=0; idx<MAT_HIST_BUCKETS; idx++)
+    {
+        if(sum->process[idx] || sum->pmi[idx] || sum->batch[idx])
+        {
+            MAT_WRITE_BUF(" %6u | %20llu | %16lld | %16lld | %16lld\n",
+                idx, idx ? 1ull << (idx - 1) : 0, sum->process[idx], sum->pmi[idx], sum->batch[idx]);
+        }
+        samples += sum->process[idx];
+        pmis    += sum->pmi[idx];
+    }
+    MAT_WRITE_BUF("samples: %lld\n", samples);
+    MAT_WRITE_BUF("pmis:    %lld\n", pmis);
+
+    kfree(sum);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_hist_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": reset histograms of every core */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    hist_clear();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(hist, S_IRUSR | S_IWUSR, dev_attr_hist_show, dev_attr_hist_store);
+
+
+
+/*
+ * setup device attributes for managing histograms
+ */
+int hist_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_hist_enabled);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_hist_enabled.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_hist_enabled.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_hist);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_hist.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_hist.attr.name );
+    return 0;
+}
+
+
+
+void hist_reset(void)
+{
+    WRITE_ONCE(gk_mat_hist_enabled, 0);
+    hist_clear();
+}
+#endif /* MAT_LATENCY_HIST */
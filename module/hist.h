@@ -0,0 +1,11 @@
+#ifndef _MAT_HIST_H
+#define _MAT_HIST_H
+
+#include <linux/mat.h>
+
+#ifdef MAT_LATENCY_HIST
+int hist_setup_devattr(void);
+void hist_reset(void);
+#endif /* MAT_LATENCY_HIST */
+
+#endif /* _MAT_HIST_H */
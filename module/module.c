@@ -24,11 +24,22 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h> /* copy_to/from_user() */
 #include <linux/cpumask.h> /* nr_cpu_ids, num_online_cpus */
+#include <linux/poll.h>    /* poll_table */
+#include <linux/uio.h>     /* iov_iter */
 
 #include "utilities.h"
 #include "flags.h"
 #include "rangecounter.h"
 #include "corebuffer.h"
+#include "hashtable.h"
+#include "filter.h"
+#include "hist.h"
+#include "adapt.h"
+#include "sketch.h"
+#include "heatmap.h"
+#include "numa.h"
+#include "strides.h"
+#include "stats.h"
 
 
 
@@ -40,21 +51,39 @@ MODULE_VERSION("0.1");
 /* prototypes for device functions */
 static int device_open(struct inode *, struct file *);
 static int device_release(struct inode *, struct file *);
-static ssize_t device_read(struct file *, char *, size_t, loff_t *);
+static ssize_t device_read_iter(struct kiocb *, struct iov_iter *);
 static ssize_t device_write(struct file *, const char *, size_t, loff_t *);
+static int device_mmap(struct file *, struct vm_area_struct *);
+static __poll_t device_poll(struct file *, poll_table *);
 
 /* handles for managing device */
 static struct cdev *gm_cdev;
 static struct class *gm_class;
 static dev_t gm_dev;
+/*
+ * number of minors: DEVICE_NAME + one device per possible CPU
+ * (+ one device per possible CPU for hash tables and for sketches,
+ * minors of hash tables are reserved if only sketches are used)
+ */
+#if defined(MAT_ADDR_SKETCH)
+#define MAT_MINORS (1 + 3*nr_cpu_ids)
+#elif defined(MAT_ADDR_HASH_TABLE)
+#define MAT_MINORS (1 + 2*nr_cpu_ids)
+#else /* MAT_ADDR_SKETCH, MAT_ADDR_HASH_TABLE */
+#define MAT_MINORS (1 + nr_cpu_ids)
+#endif /* MAT_ADDR_SKETCH, MAT_ADDR_HASH_TABLE */
 /* atomic counter for counting active calls to open at any time */
 static atomic_t gm_device_open_count;
 
 /* structure holding all of the device functions */
 static struct file_operations gm_fileops = {
     .owner = THIS_MODULE,
-    .read = device_read,
+    .read_iter = device_read_iter,
+    .splice_read = generic_file_splice_read,
+    .llseek = default_llseek,
     .write = device_write,
+    .mmap = device_mmap,
+    .poll = device_poll,
     .open = device_open,
     .release = device_release
 };
@@ -62,12 +91,35 @@ static struct file_operations gm_fileops = {
 /* called when opening device */
 static int device_open(struct inode *inode, struct file *file)
 {
-    MAT_MDBG_FUNC();
-    /* if device is already open, return busy */
-    if(atomic_read(&gm_device_open_count))
+    /*
+     * minor 0 is DEVICE_NAME, minor 1+X is the device of CPU X,
+     * minor 1+nr_cpu_ids+X is the hash table device of CPU X,
+     * minor 1+2*nr_cpu_ids+X is the sketch device of CPU X
+     */
+    const unsigned int minor = iminor(inode) - MINOR(gm_dev);
+    struct mat_file* mfile;
+
+    MAT_MDBG_FUNC( "minor=%u open_count=%d", minor, atomic_read(&gm_device_open_count) );
+    mfile = kzalloc(sizeof(struct mat_file), GFP_KERNEL);
+    if(!mfile)
     {
-        return -EBUSY;
+        return -ENOMEM;
     }
+    /* bind file to a CPU, so readers of different cores run concurrently */
+    mfile->cpu  = (minor == 0) ? gm_cpu : (int)minor - 1;
+    mfile->type = MAT_FILE_BUFFERS;
+    if(minor > 2*nr_cpu_ids)
+    {
+        mfile->cpu  = (int)(minor - 1 - 2*nr_cpu_ids);
+        mfile->type = MAT_FILE_SKETCH;
+    }
+    else if(minor > nr_cpu_ids)
+    {
+        mfile->cpu  = (int)(minor - 1 - nr_cpu_ids);
+        mfile->type = MAT_FILE_HASH_TABLE;
+    }
+    file->private_data = mfile;
+
     atomic_inc(&gm_device_open_count);
     try_module_get(THIS_MODULE);
     return 0;
@@ -77,16 +129,42 @@ static int device_open(struct inode *inode, struct file *file)
 static int device_release(struct inode *inode, struct file *file)
 {
     MAT_MDBG_FUNC();
+    kfree(file->private_data);
+    file->private_data = NULL;
     atomic_dec(&gm_device_open_count);
     module_put(THIS_MODULE);
     return 0;
 }
 
-/* called when reading from device */
-static ssize_t device_read(struct file *flip, char *buf, size_t len, loff_t *off)
+/*
+ * called when reading from device: read, readv, pread and, by
+ * generic_file_splice_read, also splice and sendfile.
+ */
+static ssize_t device_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
+    struct file* flip = iocb->ki_filp;
+    const struct mat_file* mfile = flip->private_data;
+#ifdef MAT_ADDR_HASH_TABLE
+    if(mfile->type == MAT_FILE_HASH_TABLE)
+    {
+        return hashtable_read(mfile->cpu, to, &iocb->ki_pos);
+    }
+#endif /* MAT_ADDR_HASH_TABLE */
+#ifdef MAT_ADDR_SKETCH
+    if(mfile->type == MAT_FILE_SKETCH)
+    {
+        return sketch_read(mfile->cpu, to, &iocb->ki_pos);
+    }
+#endif /* MAT_ADDR_SKETCH */
 #ifdef MAT_ADDR_BUFFERS
-    return corebuffer_read(&buf, &len, &off);
+#ifdef MAT_ADDR_STREAM
+    /* consume ring, offset is ignored */
+    if(gk_mat_buffers_stream)
+    {
+        return corebuffer_stream_read(mfile->cpu, to, (flip->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT));
+    }
+#endif /* MAT_ADDR_STREAM */
+    return corebuffer_read(mfile->cpu, to, &iocb->ki_pos);
 #endif /* MAT_ADDR_BUFFERS */
     return -ENODATA;
 }
@@ -99,12 +177,42 @@ static ssize_t device_write(struct file *flip, const char *buf, size_t len, loff
     return -EROFS;
 }
 
+/* called when mapping device into memory */
+static int device_mmap(struct file *file, struct vm_area_struct *vma)
+{
+#ifdef MAT_ADDR_BUFFERS
+    const struct mat_file* mfile = file->private_data;
+    if(mfile->type != MAT_FILE_BUFFERS)
+    {
+        return -ENODEV;
+    }
+    return corebuffer_mmap(mfile->cpu, vma);
+#endif /* MAT_ADDR_BUFFERS */
+    return -ENODEV;
+}
+
+/* called when polling device, e.g., waiting for data in streaming mode */
+static __poll_t device_poll(struct file *file, poll_table *wait)
+{
+#ifdef MAT_ADDR_BUFFERS
+    const struct mat_file* mfile = file->private_data;
+    /* hash tables and sketches are always readable */
+    if(mfile->type != MAT_FILE_BUFFERS)
+    {
+        return EPOLLIN | EPOLLRDNORM;
+    }
+    return corebuffer_poll(mfile->cpu, file, wait);
+#endif /* MAT_ADDR_BUFFERS */
+    return EPOLLERR;
+}
+
 
 
 /* LKM initialization function */
 static int __init init_lkm_module(void)
 {
     int rval;
+    int cpu;
 
     MAT_MDBG_FUNC();
     MAT_MDBG_FUNC( "@THIS_MODULE=%px NR_CPUS=%d #cpuids=%d #cpus=%d PAGE_SIZE=%ld", THIS_MODULE, NR_CPUS, nr_cpu_ids, num_online_cpus(), PAGE_SIZE );
@@ -113,7 +221,7 @@ static int __init init_lkm_module(void)
     /* create device in /dev with read/write option */
 
     /* allocate device region with @DEVICE_NAME */
-    rval = alloc_chrdev_region(&gm_dev, 1, 1, DEVICE_NAME);
+    rval = alloc_chrdev_region(&gm_dev, 1, MAT_MINORS, DEVICE_NAME);
     if (rval != 0)
     {
         MAT_MERR_FUNC( "alloc_chrdev_region" );
@@ -131,7 +239,7 @@ static int __init init_lkm_module(void)
     /* initialize device with file options */
     cdev_init(gm_cdev, &gm_fileops);
     /* add device to kernel */
-    rval = cdev_add(gm_cdev, gm_dev, 1);
+    rval = cdev_add(gm_cdev, gm_dev, MAT_MINORS);
     if (rval < 0)
     {
         MAT_MERR_FUNC( "cdev_add" );
@@ -155,20 +263,57 @@ static int __init init_lkm_module(void)
         goto device_err;
     }
     MAT_MDBG_FUNC( "created %s", DEVICE_PATH );
+    /* create one device per CPU */
+    for_each_possible_cpu(cpu)
+    {
+        struct device* cpu_device = device_create(gm_class, NULL, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + cpu), NULL, DEVICE_NAME"_cpu%d", cpu);
+        if (IS_ERR(cpu_device))
+        {
+            MAT_MERR_FUNC( "device_create %s_cpu%d", DEVICE_NAME, cpu);
+            goto cpu_device_err;
+        }
+    }
+    MAT_MDBG_FUNC( "created %s_cpu<X>", DEVICE_PATH );
+#ifdef MAT_ADDR_HASH_TABLE
+    /* create one hash table device per CPU */
+    for_each_possible_cpu(cpu)
+    {
+        struct device* cpu_device = device_create(gm_class, NULL, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + nr_cpu_ids + cpu), NULL, DEVICE_NAME"_hash_cpu%d", cpu);
+        if (IS_ERR(cpu_device))
+        {
+            MAT_MERR_FUNC( "device_create %s_hash_cpu%d", DEVICE_NAME, cpu);
+            goto cpu_device_err;
+        }
+    }
+    MAT_MDBG_FUNC( "created %s_hash_cpu<X>", DEVICE_PATH );
+#endif /* MAT_ADDR_HASH_TABLE */
+#ifdef MAT_ADDR_SKETCH
+    /* create one sketch device per CPU */
+    for_each_possible_cpu(cpu)
+    {
+        struct device* cpu_device = device_create(gm_class, NULL, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + 2*nr_cpu_ids + cpu), NULL, DEVICE_NAME"_sketch_cpu%d", cpu);
+        if (IS_ERR(cpu_device))
+        {
+            MAT_MERR_FUNC( "device_create %s_sketch_cpu%d", DEVICE_NAME, cpu);
+            goto cpu_device_err;
+        }
+    }
+    MAT_MDBG_FUNC( "created %s_sketch_cpu<X>", DEVICE_PATH );
+#endif /* MAT_ADDR_SKETCH */
 
     /* create device attributes */
     rval = utilities_setup_devattr();
     if (rval < 0)
     {
         MAT_MERR_FUNC( "failed to setup device attributes for flags" );
-        goto device_err;
+        goto cpu_device_err;
     }
 
     rval = flags_setup_devattr();
     if (rval < 0)
     {
         MAT_MERR_FUNC( "failed to setup device attributes for flags" );
-        goto device_err;
+        goto cpu_device_err;
     }
 
 #ifdef MAT_ADDR_RANGE_COUNTERS
@@ -176,7 +321,7 @@ static int __init init_lkm_module(void)
     if (rval < 0)
     {
         MAT_MERR_FUNC( "failed to setup device attributes for per-core range counters" );
-        goto device_err;
+        goto cpu_device_err;
     }
 #endif /* MAT_ADDR_RANGE_COUNTERS */
 
@@ -185,12 +330,103 @@ static int __init init_lkm_module(void)
     if (rval < 0)
     {
         MAT_MERR_FUNC( "failed to setup device attributes for per-core buffers" );
-        goto device_err;
+        goto cpu_device_err;
     }
 #endif /* MAT_ADDR_BUFFERS */
 
+#ifdef MAT_ADDR_HASH_TABLE
+    rval = hashtable_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for per-core hash tables" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_ADDR_HASH_TABLE */
+
+#if defined(MAT_FILTER_TASK) || defined(MAT_FILTER_ADDR) || defined(MAT_FILTER_MEM)
+    rval = filter_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for filters" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_FILTER_TASK || MAT_FILTER_ADDR || MAT_FILTER_MEM */
+
+#ifdef MAT_LATENCY_HIST
+    rval = hist_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for histograms" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_LATENCY_HIST */
+
+#ifdef MAT_ADAPT_PERIOD
+    rval = adapt_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for controller of sample period" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_ADAPT_PERIOD */
+
+#ifdef MAT_ADDR_SKETCH
+    rval = sketch_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for per-core sketches" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_ADDR_SKETCH */
+
+#ifdef MAT_ADDR_HEATMAP
+    rval = heatmap_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for per-core heatmaps" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_ADDR_HEATMAP */
+
+#ifdef MAT_NUMA_COUNTERS
+    rval = numa_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for NUMA counters" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_NUMA_COUNTERS */
+
+#ifdef MAT_ADDR_STRIDES
+    rval = strides_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup device attributes for histograms of address deltas" );
+        goto cpu_device_err;
+    }
+#endif /* MAT_ADDR_STRIDES */
+
+    rval = stats_setup_devattr();
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to setup binary attribute for statistics" );
+        goto cpu_device_err;
+    }
+
     return 0;
 
+cpu_device_err:
+    /* delete devices of CPUs (ignores devices not created) */
+    for_each_possible_cpu(cpu)
+    {
+        device_destroy(gm_class, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + cpu));
+#ifdef MAT_ADDR_HASH_TABLE
+        device_destroy(gm_class, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + nr_cpu_ids + cpu));
+#endif /* MAT_ADDR_HASH_TABLE */
+#ifdef MAT_ADDR_SKETCH
+        device_destroy(gm_class, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + 2*nr_cpu_ids + cpu));
+#endif /* MAT_ADDR_SKETCH */
+    }
 device_err:
     /* delete device */
     device_destroy(gm_class, gm_dev);
@@ -200,7 +436,7 @@ class_err:
     class_destroy(gm_class);
 cdev_add_err:
     /* delete device */
-    unregister_chrdev_region(gm_dev, 1);
+    unregister_chrdev_region(gm_dev, MAT_MINORS);
     cdev_del(gm_cdev);
 cdev_alloc_err:
     return -EFAULT;
@@ -209,19 +445,57 @@ cdev_alloc_err:
 /* LKM cleanup function */
 static void __exit exit_lkm_module(void)
 {
+    int cpu;
     MAT_MDBG_FUNC();
 
+    for_each_possible_cpu(cpu)
+    {
+        device_destroy(gm_class, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + cpu));
+#ifdef MAT_ADDR_HASH_TABLE
+        device_destroy(gm_class, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + nr_cpu_ids + cpu));
+#endif /* MAT_ADDR_HASH_TABLE */
+#ifdef MAT_ADDR_SKETCH
+        device_destroy(gm_class, MKDEV(MAJOR(gm_dev), MINOR(gm_dev) + 1 + 2*nr_cpu_ids + cpu));
+#endif /* MAT_ADDR_SKETCH */
+    }
     device_destroy(gm_class, gm_dev);
     class_unregister(gm_class);
     class_destroy(gm_class);
-    unregister_chrdev_region(gm_dev, 1);
+    unregister_chrdev_region(gm_dev, MAT_MINORS);
     cdev_del(gm_cdev);
 
     utilities_reset();
     flags_reset();
+#if defined(MAT_FILTER_TASK) || defined(MAT_FILTER_ADDR) || defined(MAT_FILTER_MEM)
+    filter_reset();
+#endif /* MAT_FILTER_TASK || MAT_FILTER_ADDR || MAT_FILTER_MEM */
+#ifdef MAT_ADDR_RANGE_COUNTERS
+    rangecounter_reset();
+#endif /* MAT_ADDR_RANGE_COUNTERS */
 #ifdef MAT_ADDR_BUFFERS
     corebuffer_reset();
 #endif /* MAT_ADDR_BUFFERS */
+#ifdef MAT_ADDR_HASH_TABLE
+    hashtable_reset();
+#endif /* MAT_ADDR_HASH_TABLE */
+#ifdef MAT_LATENCY_HIST
+    hist_reset();
+#endif /* MAT_LATENCY_HIST */
+#ifdef MAT_ADAPT_PERIOD
+    adapt_reset();
+#endif /* MAT_ADAPT_PERIOD */
+#ifdef MAT_ADDR_SKETCH
+    sketch_reset();
+#endif /* MAT_ADDR_SKETCH */
+#ifdef MAT_ADDR_HEATMAP
+    heatmap_reset();
+#endif /* MAT_ADDR_HEATMAP */
+#ifdef MAT_NUMA_COUNTERS
+    numa_reset();
+#endif /* MAT_NUMA_COUNTERS */
+#ifdef MAT_ADDR_STRIDES
+    strides_reset();
+#endif /* MAT_ADDR_STRIDES */
 }
 
 /* register the initialization and cleanup function of the LKM */
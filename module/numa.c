@@ -0,0 +1,351 @@
+#include "numa.h"
+
+#include <linux/device.h>   /* device (attriutes) */
+#include <linux/sysfs.h>    /* bin_attribute */
+#include <linux/cpumask.h>  /* nr_cpu_ids, for_each_cpu */
+#include <linux/nodemask.h> /* for_each_node_state */
+#include <linux/topology.h> /* cpu_to_node, topology_physical_package_id */
+#include <linux/slab.h>     /* kcalloc, kfree */
+#include <linux/math64.h>   /* div64_u64 */
+
+#include "utilities.h"
+
+#ifdef MAT_NUMA_COUNTERS
+/* row of attribute "numa": a core or the sum of the selected cores of a socket */
+struct numa_row
+{
+    int id;
+    bool socket;
+    /* samples on node of core */
+    u64 local;
+    const struct mat_numa_cnts* cnts;
+};
+
+
+
+static void numa_clear(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        memset(per_cpu_ptr(&cpu_mat_numa_cnts, cpu), 0, sizeof(struct mat_numa_cnts));
+    }
+}
+
+
+
+static u64 numa_local(const struct mat_numa_cnts* cnts, int node)
+{
+    return (node >= 0 && node < MAT_NUMA_NODES) ? cnts->samples[node] : 0;
+}
+
+
+
+/*
+ * device attribute functions for managing NUMA counters
+ */
+static ssize_t dev_attr_numa_enabled_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_numa_enabled);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_numa_enabled_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* counts only if "phys_addr" is set, too */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    WRITE_ONCE(gk_mat_numa_enabled, tmp);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(numa_enabled, S_IRUSR | S_IWUSR, dev_attr_numa_enabled_show, dev_attr_numa_enabled_store);
+
+static ssize_t dev_attr_numa_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /*
+     * samples per node (with memory) of selected cores (see "cpu") and of
+     * their sockets, "other" counts samples without node. "local" is the
+     * share of samples with node on the node of the core. if latency was
+     * sampled, a second table shows the average latency per node in cycles.
+     */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    struct numa_row* rows;
+    struct mat_numa_cnts* sums;
+    bool latency = false;
+    u32 cpus = 0;
+    u32 num;
+    u32 i;
+    u32 j;
+    int node;
+    int cpu;
+
+    rows = kcalloc(2 * nr_cpu_ids, sizeof(struct numa_row), GFP_KERNEL);
+    sums = kcalloc(nr_cpu_ids, sizeof(struct mat_numa_cnts), GFP_KERNEL);
+    if(!rows || !sums)
+    {
+        kfree(rows); kfree(sums);
+        return -ENOMEM;
+    }
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        rows[cpus].id     = cpu;
+        rows[cpus].cnts   = per_cpu_ptr(&cpu_mat_numa_cnts, cpu);
+        rows[cpus].local  = numa_local(rows[cpus].cnts, cpu_to_node(cpu));
+        cpus++;
+    }
+    /* sockets in order of their first selected core */
+    num = cpus;
+    for(i=0; i<cpus; i++)
+    {
+        const int socket = topology_physical_package_id(rows[i].id);
+        struct mat_numa_cnts* sum;
+        for(j=cpus; j<num && rows[j].id != socket; j++);
+        if(j == num)
+        {
+            rows[j].id     = socket;
+            rows[j].socket = true;
+            rows[j].cnts   = &(sums[j - cpus]);
+            num++;
+        }
+        sum = &(sums[j - cpus]);
+        for(node=0; node<=MAT_NUMA_NODES; node++)
+        {
+            sum->samples[node]  += rows[i].cnts->samples[node];
+            sum->weighted[node] += rows[i].cnts->weighted[node];
+            sum->latency[node]  += rows[i].cnts->latency[node];
+            latency = latency || rows[i].cnts->weighted[node];
+        }
+        rows[j].local += rows[i].local;
+    }
+
+    MAT_WRITE_BUF("%-10s", "samples");
+    for_each_node_state(node, N_MEMORY)
+    {
+        if(node < MAT_NUMA_NODES)
+        {
+            MAT_WRITE_BUF(" %9s%-3d", "node ", node);
+        }
+    }
+    MAT_WRITE_BUF(" %12s %7s\n", "other", "local");
+    for(i=0; i<num; i++)
+    {
+        const struct mat_numa_cnts* cnts = rows[i].cnts;
+        u64 total = 0;
+        MAT_WRITE_BUF(rows[i].socket ? "socket %-3d" : "CPU %-6d", rows[i].id);
+        for_each_node_state(node, N_MEMORY)
+        {
+            if(node < MAT_NUMA_NODES)
+            {
+                MAT_WRITE_BUF(" %12lld", cnts->samples[node]);
+            }
+        }
+        for(node=0; node<MAT_NUMA_NODES; node++)
+        {
+            total += cnts->samples[node];
+        }
+        MAT_WRITE_BUF(" %12lld %5lld.%lld%%\n", cnts->samples[MAT_NUMA_NODES],
+            total ? div64_u64(rows[i].local * 100, total) : 0,
+            total ? div64_u64(rows[i].local * 1000, total) % 10 : 0);
+    }
+
+    if(latency)
+    {
+        MAT_WRITE_BUF("\n%-10s", "latency");
+        for_each_node_state(node, N_MEMORY)
+        {
+            if(node < MAT_NUMA_NODES)
+            {
+                MAT_WRITE_BUF(" %9s%-3d", "node ", node);
+            }
+        }
+        MAT_WRITE_BUF(" %12s\n", "other");
+        for(i=0; i<num; i++)
+        {
+            const struct mat_numa_cnts* cnts = rows[i].cnts;
+            MAT_WRITE_BUF(rows[i].socket ? "socket %-3d" : "CPU %-6d", rows[i].id);
+            for(node=0; node<=MAT_NUMA_NODES; node++)
+            {
+                if(node < MAT_NUMA_NODES && !node_state(node, N_MEMORY))
+                {
+                    continue;
+                }
+                MAT_WRITE_BUF(" %12lld", cnts->weighted[node] ? div64_u64(cnts->latency[node], cnts->weighted[node]) : 0);
+            }
+            MAT_WRITE_BUF("\n");
+        }
+    }
+
+    kfree(rows);
+    kfree(sums);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_numa_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": reset counters of every core */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    numa_clear();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(numa, S_IRUSR | S_IWUSR, dev_attr_numa_show, dev_attr_numa_store);
+
+
+
+static loff_t numa_bytes(void)
+{
+    return sizeof(struct mat_numa_header) + (loff_t)nr_cpu_ids * sizeof(struct mat_numa_cpu);
+}
+
+
+
+static void numa_header(struct mat_numa_header* header)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic        = MAT_NUMA_MAGIC;
+    header->version      = MAT_NUMA_VERSION;
+    header->header_bytes = sizeof(struct mat_numa_header);
+    header->cpu_bytes    = sizeof(struct mat_numa_cpu);
+    header->cpus         = nr_cpu_ids;
+    header->nodes        = MAT_NUMA_NODES + 1;
+}
+
+
+
+static void numa_cpu(struct mat_numa_cpu* entry, int cpu)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->cpu = cpu;
+    if(!cpu_possible(cpu))
+    {
+        return;
+    }
+    entry->flags |= MAT_NUMA_POSSIBLE;
+    entry->flags |= cpumask_test_cpu(cpu, &gm_cpumask) ? MAT_NUMA_TRACED : 0;
+    entry->node   = cpu_to_node(cpu);
+    entry->socket = topology_physical_package_id(cpu);
+    memcpy(&(entry->cnts), per_cpu_ptr(&cpu_mat_numa_cnts, cpu), sizeof(struct mat_numa_cnts));
+}
+
+
+
+/*
+ * binary attribute with CPU x node matrix (see struct mat_numa_header).
+ * the file is seekable, a read may start and end within an entry.
+ */
+static ssize_t bin_attr_numa_matrix_read(struct file *file, struct kobject *kobj, struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+    const loff_t bytes = numa_bytes();
+    struct mat_numa_cpu* entry;
+    size_t done;
+
+    if(off >= bytes)
+    {
+        return 0;
+    }
+    if(count > bytes - off)
+    {
+        count = bytes - off;
+    }
+
+    /* entry of a single core (or header), copied in parts if read is not aligned */
+    BUILD_BUG_ON(sizeof(struct mat_numa_header) > sizeof(struct mat_numa_cpu));
+    entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+    if(!entry)
+    {
+        return -ENOMEM;
+    }
+    done = 0;
+    while(done < count)
+    {
+        const loff_t pos = off + done;
+        size_t begin;
+        size_t len;
+        if(pos < sizeof(struct mat_numa_header))
+        {
+            numa_header( (struct mat_numa_header*)entry );
+            begin = pos;
+            len   = sizeof(struct mat_numa_header) - begin;
+        }
+        else
+        {
+            const loff_t idx = pos - sizeof(struct mat_numa_header);
+            const int cpu = div_u64(idx, sizeof(struct mat_numa_cpu));
+            numa_cpu(entry, cpu);
+            begin = idx - (loff_t)cpu * sizeof(struct mat_numa_cpu);
+            len   = sizeof(struct mat_numa_cpu) - begin;
+        }
+        len = min(len, count - done);
+        memcpy(buf + done, (char*)entry + begin, len);
+        done += len;
+    }
+
+    kfree(entry);
+    MAT_MDBG_FUNC( "off=%lld count=%ld", off, count );
+    return count;
+}
+/* create binary attribute bin_attr_<name>, size is set on setup */
+static BIN_ATTR(numa_matrix, S_IRUSR, bin_attr_numa_matrix_read, NULL, 0);
+
+
+
+/*
+ * setup device attributes for managing NUMA counters
+ */
+int numa_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_numa_enabled);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_numa_enabled.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_numa_enabled.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_numa);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_numa.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_numa.attr.name );
+
+    bin_attr_numa_matrix.size = numa_bytes();
+    rval = device_create_bin_file(gm_device, &bin_attr_numa_matrix);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", bin_attr_numa_matrix.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s (%ld bytes)", bin_attr_numa_matrix.attr.name, bin_attr_numa_matrix.size );
+    return 0;
+}
+
+
+
+void numa_reset(void)
+{
+    WRITE_ONCE(gk_mat_numa_enabled, 0);
+    numa_clear();
+}
+#endif /* MAT_NUMA_COUNTERS */
@@ -0,0 +1,43 @@
+#ifndef _MAT_NUMA_H
+#define _MAT_NUMA_H
+
+#include <linux/mat.h>
+
+#ifdef MAT_NUMA_COUNTERS
+/*
+ * layout of binary attribute "numa_matrix": a header followed by one
+ * entry per CPU id (0 to @cpus-1), i.e., the CPU x node matrix of samples
+ * in a single read. an entry has @nodes counters per array, the last one
+ * counts samples without node (see struct mat_numa_cnts). ids that are
+ * not possible CPUs have @flags 0 and all counters 0.
+ */
+#define MAT_NUMA_MAGIC   (0x414d554e5f54414dull) /* "MAT_NUMA" in little endian */
+#define MAT_NUMA_VERSION 1
+/* @flags of an entry */
+#define MAT_NUMA_POSSIBLE (1 << 0)
+#define MAT_NUMA_TRACED   (1 << 2) /* core in "cpus" */
+struct mat_numa_header
+{
+    u64 magic;
+    u32 version;
+    u32 header_bytes;
+    u32 cpu_bytes;
+    u32 cpus;
+    u32 nodes;
+    u32 reserved;
+};
+struct mat_numa_cpu
+{
+    s32 cpu;
+    u32 flags;
+    /* node and socket (physical package) of core */
+    s32 node;
+    s32 socket;
+    struct mat_numa_cnts cnts;
+};
+
+int numa_setup_devattr(void);
+void numa_reset(void);
+#endif /* MAT_NUMA_COUNTERS */
+
+#endif /* _MAT_NUMA_H */
@@ -2,6 +2,9 @@
 
 #include <linux/device.h>  /* device (attriutes) */
 #include <linux/cpumask.h> /* nr_cpu_ids, num_online_cpus */
+#include <linux/slab.h>    /* kzalloc, kfree */
+#include <linux/percpu.h>  /* alloc_percpu, free_percpu */
+#include <linux/mutex.h>   /* mutex_lock/unlock */
 #include <linux/mat.h>
 
 #include "utilities.h"
@@ -9,28 +12,139 @@
 
 
 #ifdef MAT_ADDR_RANGE_COUNTERS
+/* serializes writers of gk_mat_ranges */
+static DEFINE_MUTEX(gm_ranges_mutex);
+
+/* default boundaries (without implicit boundary 0), same ranges as mat_addr_range */
+static const u64 gm_default_bounds[] = {
+    0x40000000ull, 0x7d0000000000ull, 0x7ff000000000ull, 0xfff000000000000ull
+};
+
+
+
+/* create table of ranges with boundaries 0 and @bounds[0..@num-1] (sorted) */
+static struct mat_ranges* ranges_create(const u64* bounds, u32 num)
+{
+    struct mat_ranges* ranges;
+    u32 i;
+
+    if(num + 1 > MAT_RANGE_BOUNDS)
+    {
+        return NULL;
+    }
+    ranges = kzalloc(sizeof(struct mat_ranges), GFP_KERNEL);
+    if(!ranges)
+    {
+        MAT_MERR_FUNC( "failed kzalloc" );
+        return NULL;
+    }
+    /* one counter per range and core */
+    ranges->cnts = __alloc_percpu(sizeof(u64) * (num + 2), sizeof(u64));
+    if(!ranges->cnts)
+    {
+        MAT_MERR_FUNC( "failed alloc_percpu %d counters", num + 2 );
+        kfree(ranges);
+        return NULL;
+    }
+    ranges->num = num + 1;
+    ranges->bounds[0] = 0;
+    for(i=1; i<MAT_RANGE_BOUNDS; i++)
+    {
+        ranges->bounds[i] = (i <= num) ? bounds[i-1] : U64_MAX;
+    }
+    return ranges;
+}
+
+
+
+static void ranges_destroy(struct mat_ranges* ranges)
+{
+    if(ranges)
+    {
+        free_percpu(ranges->cnts);
+        kfree(ranges);
+    }
+}
+
+
+
+/* publish @ranges (may be NULL) and free previous table after readers finished */
+static void ranges_replace(struct mat_ranges* ranges)
+{
+    struct mat_ranges* old;
+
+    mutex_lock(&gm_ranges_mutex);
+    old = rcu_dereference_protected(gk_mat_ranges, lockdep_is_held(&gm_ranges_mutex));
+    rcu_assign_pointer(gk_mat_ranges, ranges);
+    mutex_unlock(&gm_ranges_mutex);
+
+    /* producer (NMI) and readers of attributes may still use @old */
+    synchronize_rcu();
+    ranges_destroy(old);
+}
+
+
+
+/* sum of counter of range @idx of core @cpu or of all selected cores if @cpu < 0 */
+static u64 ranges_sum(struct mat_ranges* ranges, int cpu, u32 idx)
+{
+    u64 sum = 0;
+    int i;
+    if(cpu >= 0)
+    {
+        return per_cpu_ptr(ranges->cnts, cpu)[idx];
+    }
+    for_each_cpu(i, &gm_cpus_selected)
+    {
+        sum += per_cpu_ptr(ranges->cnts, i)[idx];
+    }
+    return sum;
+}
+
+
+
+/* set counters of every core to 0 */
+static void ranges_clear(void)
+{
+    struct mat_ranges* ranges;
+    int cpu;
+
+    rcu_read_lock();
+    ranges = rcu_dereference(gk_mat_ranges);
+    if(ranges)
+    {
+        for_each_possible_cpu(cpu)
+        {
+            memset(per_cpu_ptr(ranges->cnts, cpu), 0, sizeof(u64) * (ranges->num + 1));
+        }
+    }
+    rcu_read_unlock();
+}
+
+
+
 static ssize_t dev_attr_samples_total_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
     /* read device attribute (one line + \n) */
     const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
     bool  buf_full = false;            /* used by MAT_WRITE_BUF */
-    const int CPUS = num_online_cpus();
+    struct mat_ranges* ranges;
     u64 samples_total;
-    int i;
+    u32 idx;
 
     MAT_MDBG_FUNC();
     /* sum samples counters of each core */
     samples_total = 0;
-    for(i=0; i<CPUS; i++)
+    rcu_read_lock();
+    ranges = rcu_dereference(gk_mat_ranges);
+    if(ranges)
     {
-        struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, i);
-        samples_total += rcnt->cnts[0];
-        samples_total += rcnt->cnts[1];
-        samples_total += rcnt->cnts[2];
-        samples_total += rcnt->cnts[3];
-        samples_total += rcnt->cnts[4];
-        samples_total += rcnt->cnts[5];
+        for(idx=0; idx<=ranges->num; idx++)
+        {
+            samples_total += ranges_sum(ranges, -1, idx);
+        }
     }
+    rcu_read_unlock();
 
     MAT_WRITE_BUF( "%lld\n", samples_total);
     MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
@@ -39,8 +153,6 @@ static ssize_t dev_attr_samples_total_show(struct device *dev, struct device_att
 static ssize_t dev_attr_samples_total_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
     int tmp;
-    const int CPUS = num_online_cpus();
-    int i;
 
     MAT_MDBG_FUNC();
     tmp = 1;
@@ -49,17 +161,7 @@ static ssize_t dev_attr_samples_total_store(struct device *dev, struct device_at
     {
         MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
         /* if 0 reset sample range counter of each core */
-        for(i=0; i<CPUS; i++)
-        {
-            struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, i);
-            rcnt->cnts[0] = 0;
-            rcnt->cnts[1] = 0;
-            rcnt->cnts[2] = 0;
-            rcnt->cnts[3] = 0;
-            rcnt->cnts[4] = 0;
-            rcnt->cnts[5] = 0;
-        }
-
+        ranges_clear();
         return count;
     }
     /* otherwise report invalid argument and do nothing */
@@ -73,121 +175,48 @@ static DEVICE_ATTR(samples_total, S_IRUSR | S_IWUSR, dev_attr_samples_total_show
 
 static ssize_t dev_attr_samples_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
-    /* read device attribute (one line + \n) */
+    /*
+     * one line per range with #samples of core @gm_cpu
+     * or of all selected cores if @gm_cpu < 0
+     */
     const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
     bool  buf_full = false;            /* used by MAT_WRITE_BUF */
-    const int CPUS = num_online_cpus();
-    int i;
-    u64 counter;
-    u64 total_cnt = 0;
-    u64 total_rcnt_0 = 0;
-    u64 total_rcnt_1 = 0;
-    u64 total_rcnt_2 = 0;
-    u64 total_rcnt_3 = 0;
-    u64 total_rcnt_4 = 0;
-    u64 total_rcnt_5 = 0;
+    struct mat_ranges* ranges;
+    u32 idx;
 
     MAT_MDBG_FUNC();
 
-    /* get total count for every range to print summary line */
-    total_cnt = 0;
-    for(i=0; i<CPUS; i++)
-    {
-        struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, i);
-        total_rcnt_0 += rcnt->cnts[0];
-        total_rcnt_1 += rcnt->cnts[1];
-        total_rcnt_2 += rcnt->cnts[2];
-        total_rcnt_3 += rcnt->cnts[3];
-        total_rcnt_4 += rcnt->cnts[4];
-        total_rcnt_5 += rcnt->cnts[5];
-        total_cnt += total_rcnt_0 + total_rcnt_1 +
-                   total_rcnt_2 + total_rcnt_3 +
-                   total_rcnt_4 + total_rcnt_5;
-    }
-
-    if(total_cnt && CPUS)
+    rcu_read_lock();
+    ranges = rcu_dereference(gk_mat_ranges);
+    if(ranges)
     {
-        MAT_WRITE_BUF(" %3s | <= 0x%016llx[%d] "
-                "| <= 0x%016llx[%d] | <= 0x%016llx[%d] | <= 0x%016llx[%d] "
-                "| <= 0x%016llx[%d] | <= 0x%016llx[%d]\n",
-                "CPU",
-                0x0ull,                mat_addr_range(0x0ull),
-                0x40000000ull,         mat_addr_range(0x40000000ull),
-                0x7d0000000000ull,     mat_addr_range(0x7d0000000000ull),
-                0x7ff000000000ull,     mat_addr_range(0x7ff000000000ull),
-                0xfff000000000000ull,  mat_addr_range(0xfff000000000000ull),
-                0xffffffffffffffffull, mat_addr_range(0xffffffffffffffffull));
-        MAT_WRITE_BUF("-----+--------------------------+"
-            "--------------------------+--------------------------+"
-            "--------------------------+--------------------------+"
-            "--------------------------\n");
-
         if(gm_cpu < 0)
         {
-            MAT_WRITE_BUF(" %3s | %24lld | %24lld | %24lld "
-                    "| %24lld | %24lld | %24lld\n",
-                    "ALL",
-                    total_rcnt_0,
-                    total_rcnt_1,
-                    total_rcnt_2,
-                    total_rcnt_3,
-                    total_rcnt_4,
-                    total_rcnt_5);
-            MAT_WRITE_BUF("-----+--------------------------+"
-                "--------------------------+--------------------------+"
-                "--------------------------+--------------------------+"
-                "--------------------------\n");
+            MAT_WRITE_BUF(" %5s | %18s | %18s | %24s\n", "range", "> lower bound", "<= upper bound", "samples (ALL)");
         }
-    }
-
-    if(gm_cpu < 0)
-    {
-        /* sum samples counters of each core */
-        for(i=0; i<CPUS; i++)
+        else
         {
-            struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, i);
-            counter  = rcnt->cnts[0];
-            counter += rcnt->cnts[1];
-            counter += rcnt->cnts[2];
-            counter += rcnt->cnts[3];
-            counter += rcnt->cnts[4];
-            counter += rcnt->cnts[5];
-            if( counter )
-            {
-                MAT_WRITE_BUF(" %3d | %24lld | %24lld | %24lld "
-                        "| %24lld | %24lld | %24lld\n",
-                        i,
-                        rcnt->cnts[mat_addr_range(0x0ull)],
-                        rcnt->cnts[mat_addr_range(0x40000000ull)],
-                        rcnt->cnts[mat_addr_range(0x7d0000000000ull)],
-                        rcnt->cnts[mat_addr_range(0x7ff000000000ull)],
-                        rcnt->cnts[mat_addr_range(0xfff000000000000ull)],
-                        rcnt->cnts[mat_addr_range(0xffffffffffffffffull)]);
-            }
+            MAT_WRITE_BUF(" %5s | %18s | %18s | %18s %3d\n", "range", "> lower bound", "<= upper bound", "samples CPU", gm_cpu);
         }
-    }
-    else if(gm_cpu >= 0 && gm_cpu < CPUS)
-    {
-        struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, gm_cpu);
-        counter  = rcnt->cnts[0];
-        counter += rcnt->cnts[1];
-        counter += rcnt->cnts[2];
-        counter += rcnt->cnts[3];
-        counter += rcnt->cnts[4];
-        counter += rcnt->cnts[5];
-        if( counter )
+        MAT_WRITE_BUF("-------+--------------------+--------------------+--------------------------\n");
+        for(idx=0; idx<=ranges->num; idx++)
         {
-            MAT_WRITE_BUF(" %3d | %24lld | %24lld | %24lld "
-                    "| %24lld | %24lld | %24lld\n",
-                    gm_cpu,
-                    rcnt->cnts[mat_addr_range(0x0ull)],
-                    rcnt->cnts[mat_addr_range(0x40000000ull)],
-                    rcnt->cnts[mat_addr_range(0x7d0000000000ull)],
-                    rcnt->cnts[mat_addr_range(0x7ff000000000ull)],
-                    rcnt->cnts[mat_addr_range(0xfff000000000000ull)],
-                    rcnt->cnts[mat_addr_range(0xffffffffffffffffull)]);
+            const u64 samples = ranges_sum(ranges, gm_cpu, idx);
+            if(idx == 0)
+            {
+                MAT_WRITE_BUF(" %5d | %18s | 0x%016llx | %24lld\n", idx, "", ranges->bounds[idx], samples);
+            }
+            else if(idx == ranges->num)
+            {
+                MAT_WRITE_BUF(" %5d | 0x%016llx | %18s | %24lld\n", idx, ranges->bounds[idx-1], "", samples);
+            }
+            else
+            {
+                MAT_WRITE_BUF(" %5d | 0x%016llx | 0x%016llx | %24lld\n", idx, ranges->bounds[idx-1], ranges->bounds[idx], samples);
+            }
         }
     }
+    rcu_read_unlock();
 
     if( buf == buf_begin )
     {
@@ -199,9 +228,7 @@ static ssize_t dev_attr_samples_show(struct device *dev, struct device_attribute
 }
 static ssize_t dev_attr_samples_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-    const int CPUS = num_online_cpus();
     int tmp;
-    int i;
 
     MAT_MDBG_FUNC();
     tmp = 1;
@@ -210,17 +237,7 @@ static ssize_t dev_attr_samples_store(struct device *dev, struct device_attribut
     {
         MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
         /* if 0, reset sample counter of each core */
-        for(i=0; i<CPUS; i++)
-        {
-            struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, i);
-            rcnt->cnts[0] = 0;
-            rcnt->cnts[1] = 0;
-            rcnt->cnts[2] = 0;
-            rcnt->cnts[3] = 0;
-            rcnt->cnts[4] = 0;
-            rcnt->cnts[5] = 0;
-        }
-
+        ranges_clear();
         return count;
     }
     /* otherwise report invalid argument and do nothing */
@@ -237,23 +254,24 @@ static ssize_t dev_attr_samples_total_nz_show(struct device *dev, struct device_
     /* read device attribute (one line + \n) */
     const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
     bool  buf_full = false;            /* used by MAT_WRITE_BUF */
-    const int CPUS = num_online_cpus();
+    struct mat_ranges* ranges;
     u64 samples_total_nz;
-    int i;
+    u32 idx;
 
     MAT_MDBG_FUNC();
     /* sum samples counters of each core */
     samples_total_nz = 0;
-    for(i=0; i<CPUS; i++)
+    rcu_read_lock();
+    ranges = rcu_dereference(gk_mat_ranges);
+    if(ranges)
     {
-        struct mat_range_cnt* rcnt = per_cpu_ptr(&cpu_mat_range_cnts, i);
-        /* skip counters for address 0x0 */
-        samples_total_nz += rcnt->cnts[1];
-        samples_total_nz += rcnt->cnts[2];
-        samples_total_nz += rcnt->cnts[3];
-        samples_total_nz += rcnt->cnts[4];
-        samples_total_nz += rcnt->cnts[5];
+        /* skip counters for address 0x0 (range 0) */
+        for(idx=1; idx<=ranges->num; idx++)
+        {
+            samples_total_nz += ranges_sum(ranges, -1, idx);
+        }
     }
+    rcu_read_unlock();
 
     MAT_WRITE_BUF( "%lld\n", samples_total_nz);
     MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
@@ -266,12 +284,107 @@ static ssize_t dev_attr_samples_total_nz_store(struct device *dev, struct device
 /* create device attribute dev_attr_<name> */
 static DEVICE_ATTR(samples_total_nz, S_IRUSR | S_IWUSR, dev_attr_samples_total_nz_show, dev_attr_samples_total_nz_store);
 
+static ssize_t dev_attr_ranges_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* upper boundaries of ranges (without implicit boundary 0), one per line */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    struct mat_ranges* ranges;
+    u32 idx;
+
+    rcu_read_lock();
+    ranges = rcu_dereference(gk_mat_ranges);
+    if(ranges)
+    {
+        for(idx=1; idx<ranges->num; idx++)
+        {
+            MAT_WRITE_BUF( "0x%016llx\n", ranges->bounds[idx]);
+        }
+    }
+    rcu_read_unlock();
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_ranges_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * "default": restore default boundaries
+     * "B1 B2 ...": strictly increasing upper boundaries separated by
+     *              spaces, commas or newlines (decimal or 0x hexadecimal),
+     *              at most MAT_RANGE_BOUNDS-1. counters start at 0.
+     */
+    struct mat_ranges* ranges;
+    u64 bounds[MAT_RANGE_BOUNDS];
+    char* args;
+    char* cursor;
+    char* token;
+    u32 num;
+
+    if(sysfs_streq(buf, "default"))
+    {
+        ranges = ranges_create(gm_default_bounds, ARRAY_SIZE(gm_default_bounds));
+        if(!ranges)
+        {
+            return -ENOMEM;
+        }
+        ranges_replace(ranges);
+        return count;
+    }
+
+    args = kstrndup(buf, count, GFP_KERNEL);
+    if(!args)
+    {
+        return -ENOMEM;
+    }
+    num = 0;
+    cursor = args;
+    while((token = strsep(&cursor, " ,\n")) != NULL)
+    {
+        if(*token == '\0')
+        {
+            continue;
+        }
+        /* boundary 0 is implicit */
+        if(num + 1 >= MAT_RANGE_BOUNDS || kstrtou64(token, 0, &bounds[num]) ||
+           bounds[num] == 0 || (num > 0 && bounds[num] <= bounds[num-1]))
+        {
+            MAT_MERR_FUNC( "invalid boundary %s (#%d)", token, num );
+            kfree(args);
+            return -EINVAL;
+        }
+        num++;
+    }
+    kfree(args);
+    MAT_MDBG_FUNC( "count=%ld num=%d", count, num );
+
+    ranges = ranges_create(bounds, num);
+    if(!ranges)
+    {
+        return -ENOMEM;
+    }
+    ranges_replace(ranges);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(ranges, S_IRUSR | S_IWUSR, dev_attr_ranges_show, dev_attr_ranges_store);
+
 
 
 
 int rangecounter_setup_devattr(void)
 {
     int rval;
+    struct mat_ranges* ranges;
+
+    ranges = ranges_create(gm_default_bounds, ARRAY_SIZE(gm_default_bounds));
+    if(!ranges)
+    {
+        MAT_MERR_FUNC( "failed to create default ranges" );
+        return -1;
+    }
+    ranges_replace(ranges);
+
     rval = device_create_file(gm_device, &dev_attr_samples_total);
     if (rval < 0)
     {
@@ -279,7 +392,7 @@ int rangecounter_setup_devattr(void)
         return -1;
     }
     MAT_MDBG_FUNC( "created %s", dev_attr_samples_total.attr.name );
-    
+
     rval = device_create_file(gm_device, &dev_attr_samples);
     if (rval < 0)
     {
@@ -295,7 +408,22 @@ int rangecounter_setup_devattr(void)
         return -1;
     }
     MAT_MDBG_FUNC( "created %s", dev_attr_samples_total_nz.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_ranges);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_ranges.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_ranges.attr.name );
     return rval;
 }
-#endif /* MAT_ADDR_RANGE_COUNTERS */
 
+
+
+void rangecounter_reset(void)
+{
+    /* stop counting, counters of the kernel are owned by the module */
+    ranges_replace(NULL);
+}
+#endif /* MAT_ADDR_RANGE_COUNTERS */
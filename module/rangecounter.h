@@ -3,6 +3,7 @@
 
 #ifdef MAT_ADDR_RANGE_COUNTERS
 int rangecounter_setup_devattr(void);
+void rangecounter_reset(void);
 #endif /* MAT_ADDR_RANGE_COUNTERS */
 
 #endif /* _MAT_RANGECOUNTER_H */
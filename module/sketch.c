@@ -0,0 +1,578 @@
+#include "sketch.h"
+
+#include <linux/slab.h>        /* kcalloc, kvzalloc_node, kvcalloc, kvfree */
+#include <linux/device.h>      /* device (attriutes) */
+#include <linux/uio.h>         /* copy_to_iter */
+#include <linux/cpumask.h>     /* nr_cpu_ids, for_each_cpu */
+#include <linux/topology.h>    /* cpu_to_node */
+#include <linux/mutex.h>       /* mutex_lock/unlock */
+#include <linux/workqueue.h>   /* delayed_work */
+#include <linux/timekeeping.h> /* ktime_get_ns */
+#include <linux/rcupdate.h>    /* synchronize_rcu */
+#include <linux/log2.h>        /* ilog2 */
+#include <linux/math64.h>      /* div64_u64, div_u64_rem */
+#include <linux/jiffies.h>     /* msecs_to_jiffies */
+
+#include "utilities.h"
+
+#ifdef MAT_ADDR_SKETCH
+/* history of a core: ring of @gm_sketch_history epochs, @num epochs written in total */
+struct sketch_history
+{
+    struct mat_sketch_epoch* epochs;
+    u64 num;
+};
+
+/*
+ * @gm_sketch_mutex protects sets and histories of all cores, i.e., rotating
+ * sets at the end of an epoch, reading histories and (de)allocating.
+ * @gm_sketch_ctl_mutex serializes starting and stopping (device attributes),
+ * it is not taken by the work rotating epochs, so stopping can wait for it.
+ */
+static DEFINE_MUTEX(gm_sketch_mutex);
+static DEFINE_MUTEX(gm_sketch_ctl_mutex);
+/* histories of all CPU ids, allocated for traced cores */
+static struct sketch_history* gm_sketch_histories = NULL;
+/* length of an epoch in ms and number of epochs kept per core */
+static u32 gm_sketch_epoch_ms = 1000;
+static u32 gm_sketch_history = 256;
+/* number and start of current epoch */
+static u64 gm_sketch_seq = 0;
+static u64 gm_sketch_start = 0;
+/* epochs are rotated while true */
+static bool gm_sketch_running = false;
+
+static void sketch_work_func(struct work_struct *work);
+static DECLARE_DELAYED_WORK(gm_sketch_work, sketch_work_func);
+
+
+
+/* log2(@x) in fixed point with 16 fractional bits, @x >= 1 */
+static u64 sketch_log2(u64 x)
+{
+    const u32 exp = ilog2(x);
+    /* mantissa in [1, 2) with 31 fractional bits, squaring yields one bit each */
+    u64 m = (exp > 31) ? x >> (exp - 31) : x << (31 - exp);
+    u64 result = (u64)exp << 16;
+    int bit;
+
+    for(bit=15; bit>=0; bit--)
+    {
+        m = (m * m) >> 31;
+        if(m >= (2ull << 31))
+        {
+            m >>= 1;
+            result |= 1ull << bit;
+        }
+    }
+    return result;
+}
+
+
+
+/*
+ * HyperLogLog estimate of distinct keys: alpha * m^2 / sum(2^-reg).
+ * for small estimates (<= 5/2 m) with empty registers, use linear
+ * counting m * ln(m / #empty registers) instead.
+ */
+static u64 sketch_hll_estimate(const u8* regs)
+{
+    const u64 m = MAT_SKETCH_HLL_REGS;
+    /* alpha = 0.7213 / (1 + 1.079 / m) with 16 fractional bits */
+    const u64 alpha = div64_u64(47271ull * 1000 * m, 1000 * m + 1079);
+    /* sum of 2^-reg with 52 fractional bits, ranks above 52 add (almost) nothing */
+    u64 sum = 0;
+    u64 zeros = 0;
+    u64 estimate;
+    u32 i;
+
+    BUILD_BUG_ON(2 * MAT_SKETCH_HLL_BITS + 52 - 32 > 64 - 16);
+    for(i=0; i<MAT_SKETCH_HLL_REGS; i++)
+    {
+        if(regs[i] <= 52)
+        {
+            sum += 1ull << (52 - regs[i]);
+        }
+        if(regs[i] == 0)
+        {
+            zeros++;
+        }
+    }
+    estimate = div64_u64(alpha << (2 * MAT_SKETCH_HLL_BITS + 52 - 32), max_t(u64, sum >> 16, 1));
+    if(estimate <= 5 * m / 2 && zeros)
+    {
+        /* ln(2) with 16 fractional bits is 45426 */
+        estimate = (m * 45426 * (sketch_log2(m) - sketch_log2(zeros))) >> 32;
+    }
+    return estimate;
+}
+
+
+
+/* entry of the history for @set, which ended at @end */
+static void sketch_finish(struct mat_sketch_epoch* epoch, const struct mat_sketch_set* set, u64 end)
+{
+    u32 num = 0;
+    u32 i;
+    u32 j;
+
+    memset(epoch, 0, sizeof(*epoch));
+    epoch->seq     = gm_sketch_seq;
+    epoch->start   = gm_sketch_start;
+    epoch->end     = end;
+    epoch->samples = set->samples;
+    if(set->samples)
+    {
+        /* an estimate above the number of samples is known to be wrong */
+        epoch->lines = min(sketch_hll_estimate(set->lines), set->samples);
+        epoch->pages = min(sketch_hll_estimate(set->pages), set->samples);
+    }
+    /* top pages sorted by count, highest first */
+    for(i=0; i<MAT_SKETCH_TOPK; i++)
+    {
+        if(!set->top_counts[i])
+        {
+            continue;
+        }
+        for(j=num; j>0 && epoch->top_counts[j-1] < set->top_counts[i]; j--)
+        {
+            epoch->top_pages[j]  = epoch->top_pages[j-1];
+            epoch->top_counts[j] = epoch->top_counts[j-1];
+        }
+        epoch->top_pages[j]  = set->top_pages[i];
+        epoch->top_counts[j] = set->top_counts[i];
+        num++;
+    }
+}
+
+
+
+/* end current epoch of every core with sketches, holds @gm_sketch_mutex */
+static void sketch_rotate(void)
+{
+    const u64 end = ktime_get_ns();
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_sketch* sketch = per_cpu_ptr(&cpu_mat_sketches, cpu);
+        if(sketch->sets[0])
+        {
+            WRITE_ONCE(sketch->active, sketch->active ^ 1);
+        }
+    }
+    /* producers (NMIs) still filling the previous sets finish before a grace period ends */
+    synchronize_rcu();
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_sketch* sketch = per_cpu_ptr(&cpu_mat_sketches, cpu);
+        struct mat_sketch_set* set = sketch->sets[sketch->active ^ 1];
+        struct sketch_history* history;
+        u32 slot;
+        if(!set)
+        {
+            continue;
+        }
+        history = &(gm_sketch_histories[cpu]);
+        div_u64_rem(history->num, gm_sketch_history, &slot);
+        sketch_finish(&(history->epochs[slot]), set, end);
+        history->num += 1;
+        memset(set, 0, sizeof(*set));
+    }
+    gm_sketch_seq  += 1;
+    gm_sketch_start = end;
+}
+
+
+
+static void sketch_work_func(struct work_struct *work)
+{
+    mutex_lock(&gm_sketch_mutex);
+    if(gm_sketch_running)
+    {
+        sketch_rotate();
+        schedule_delayed_work(&gm_sketch_work, msecs_to_jiffies(gm_sketch_epoch_ms));
+    }
+    mutex_unlock(&gm_sketch_mutex);
+}
+
+
+
+/* free sets and histories of every core, producers must be stopped; holds @gm_sketch_mutex */
+static void sketch_destroy(void)
+{
+    int cpu;
+
+    /* wait for producers that saw sketches enabled */
+    synchronize_rcu();
+    for_each_possible_cpu(cpu)
+    {
+        struct mat_sketch* sketch = per_cpu_ptr(&cpu_mat_sketches, cpu);
+        kvfree(sketch->sets[0]);
+        kvfree(sketch->sets[1]);
+        sketch->sets[0] = NULL;
+        sketch->sets[1] = NULL;
+        sketch->active  = 0;
+        if(gm_sketch_histories)
+        {
+            kvfree(gm_sketch_histories[cpu].epochs);
+        }
+    }
+    kfree(gm_sketch_histories);
+    gm_sketch_histories = NULL;
+}
+
+
+
+/* allocate sets (on node of core) and histories of traced cores; holds @gm_sketch_mutex */
+static int sketch_create(void)
+{
+    int cpu;
+
+    gm_sketch_histories = kcalloc(nr_cpu_ids, sizeof(struct sketch_history), GFP_KERNEL);
+    if(!gm_sketch_histories)
+    {
+        return -ENOMEM;
+    }
+    for_each_cpu(cpu, &gm_cpumask)
+    {
+        struct mat_sketch* sketch = per_cpu_ptr(&cpu_mat_sketches, cpu);
+        const int node = cpu_to_node(cpu);
+        sketch->sets[0] = kvzalloc_node(sizeof(struct mat_sketch_set), GFP_KERNEL, node);
+        sketch->sets[1] = kvzalloc_node(sizeof(struct mat_sketch_set), GFP_KERNEL, node);
+        gm_sketch_histories[cpu].epochs = kvcalloc(gm_sketch_history, sizeof(struct mat_sketch_epoch), GFP_KERNEL);
+        if(!sketch->sets[0] || !sketch->sets[1] || !gm_sketch_histories[cpu].epochs)
+        {
+            MAT_MERR_FUNC( "failed to allocate sketches of cpu=%d", cpu );
+            sketch_destroy();
+            return -ENOMEM;
+        }
+    }
+    MAT_MDBG_FUNC( "%ld bytes of sets and %ld bytes of history per core",
+        2 * sizeof(struct mat_sketch_set), gm_sketch_history * sizeof(struct mat_sketch_epoch) );
+    return 0;
+}
+
+
+
+/* start first epoch with new sets and empty histories; holds @gm_sketch_ctl_mutex */
+static int sketch_start(void)
+{
+    int rval;
+
+    if(gm_sketch_running)
+    {
+        return 0;
+    }
+    mutex_lock(&gm_sketch_mutex);
+    sketch_destroy();
+    rval = sketch_create();
+    if(rval == 0)
+    {
+        gm_sketch_seq     = 0;
+        gm_sketch_start   = ktime_get_ns();
+        gm_sketch_running = true;
+        WRITE_ONCE(gk_mat_sketch_enabled, 1);
+        schedule_delayed_work(&gm_sketch_work, msecs_to_jiffies(gm_sketch_epoch_ms));
+    }
+    mutex_unlock(&gm_sketch_mutex);
+    return rval;
+}
+
+
+
+/* stop producers and epochs, the last (partial) epoch is added to histories; holds @gm_sketch_ctl_mutex */
+static void sketch_stop(void)
+{
+    bool running;
+
+    mutex_lock(&gm_sketch_mutex);
+    running = gm_sketch_running;
+    gm_sketch_running = false;
+    WRITE_ONCE(gk_mat_sketch_enabled, 0);
+    mutex_unlock(&gm_sketch_mutex);
+    if(!running)
+    {
+        return;
+    }
+    cancel_delayed_work_sync(&gm_sketch_work);
+    mutex_lock(&gm_sketch_mutex);
+    sketch_rotate();
+    mutex_unlock(&gm_sketch_mutex);
+}
+
+
+
+/*
+ * device attribute functions for managing per-core sketches
+ */
+static ssize_t dev_attr_sketch_enabled_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_sketch_enabled);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_sketch_enabled_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * "1": allocate sketches on traced cores, drop histories and start epochs
+     * "0": stop epochs, histories stay readable
+     */
+    int rval = 0;
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    mutex_lock(&gm_sketch_ctl_mutex);
+    if(tmp)
+    {
+        rval = sketch_start();
+    }
+    else
+    {
+        sketch_stop();
+    }
+    mutex_unlock(&gm_sketch_ctl_mutex);
+    return (rval < 0) ? rval : count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(sketch_enabled, S_IRUSR | S_IWUSR, dev_attr_sketch_enabled_show, dev_attr_sketch_enabled_store);
+
+static ssize_t dev_attr_sketch_epoch_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", gm_sketch_epoch_ms);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_sketch_epoch_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* length of an epoch in ms, at least 10 (every epoch waits for an RCU grace period) */
+    unsigned int tmp;
+    ssize_t rval = count;
+
+    if(kstrtouint(buf, 0, &tmp) || tmp < 10)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%u", count, tmp );
+    mutex_lock(&gm_sketch_ctl_mutex);
+    if(gm_sketch_running)
+    {
+        MAT_MERR_FUNC( "disable sketches before changing epoch" );
+        rval = -EBUSY;
+    }
+    else
+    {
+        gm_sketch_epoch_ms = tmp;
+    }
+    mutex_unlock(&gm_sketch_ctl_mutex);
+    return rval;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(sketch_epoch, S_IRUSR | S_IWUSR, dev_attr_sketch_epoch_show, dev_attr_sketch_epoch_store);
+
+static ssize_t dev_attr_sketch_history_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%u\n", gm_sketch_history);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_sketch_history_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* number of epochs kept per core (ring), histories are dropped */
+    unsigned int tmp;
+    ssize_t rval = count;
+
+    if(kstrtouint(buf, 0, &tmp) || tmp < 1 || tmp > (1 << 20))
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%u", count, tmp );
+    mutex_lock(&gm_sketch_ctl_mutex);
+    if(gm_sketch_running)
+    {
+        MAT_MERR_FUNC( "disable sketches before changing history" );
+        rval = -EBUSY;
+    }
+    else
+    {
+        mutex_lock(&gm_sketch_mutex);
+        sketch_destroy();
+        gm_sketch_history = tmp;
+        mutex_unlock(&gm_sketch_mutex);
+    }
+    mutex_unlock(&gm_sketch_ctl_mutex);
+    return rval;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(sketch_history, S_IRUSR | S_IWUSR, dev_attr_sketch_history_show, dev_attr_sketch_history_store);
+
+static ssize_t dev_attr_sketch_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /* last finished epoch of selected cores (see "cpu"), top pages as addresses */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    int cpu;
+    u32 i;
+
+    mutex_lock(&gm_sketch_mutex);
+    MAT_WRITE_BUF("epochs: %lld (%u ms), history: %u epochs\n", gm_sketch_seq, gm_sketch_epoch_ms, gm_sketch_history);
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        const struct sketch_history* history;
+        const struct mat_sketch_epoch* epoch;
+        u32 slot;
+        if(!gm_sketch_histories || !gm_sketch_histories[cpu].num)
+        {
+            continue;
+        }
+        history = &(gm_sketch_histories[cpu]);
+        div_u64_rem(history->num - 1, gm_sketch_history, &slot);
+        epoch = &(history->epochs[slot]);
+        MAT_WRITE_BUF("CPU %2d: epoch=%lld samples=%lld lines=%lld pages=%lld top=",
+            cpu, epoch->seq, epoch->samples, epoch->lines, epoch->pages);
+        for(i=0; i<MAT_SKETCH_TOPK && epoch->top_counts[i]; i++)
+        {
+            MAT_WRITE_BUF("%s0x%llx:%lld", i ? "," : "", epoch->top_pages[i] << MAT_SKETCH_PAGE_SHIFT, epoch->top_counts[i]);
+        }
+        MAT_WRITE_BUF("\n");
+    }
+    mutex_unlock(&gm_sketch_mutex);
+
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_sketch_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": stop epochs and free sketches and histories of every core */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    sketch_reset();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(sketch, S_IRUSR | S_IWUSR, dev_attr_sketch_show, dev_attr_sketch_store);
+
+
+
+/*
+ * setup device attributes for managing per-core sketches
+ */
+int sketch_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_sketch_enabled);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_sketch_enabled.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_sketch_enabled.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_sketch_epoch);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_sketch_epoch.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_sketch_epoch.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_sketch_history);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_sketch_history.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_sketch_history.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_sketch);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_sketch.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_sketch.attr.name );
+    return 0;
+}
+
+
+
+void sketch_reset(void)
+{
+    mutex_lock(&gm_sketch_ctl_mutex);
+    sketch_stop();
+    mutex_lock(&gm_sketch_mutex);
+    sketch_destroy();
+    mutex_unlock(&gm_sketch_mutex);
+    mutex_unlock(&gm_sketch_ctl_mutex);
+}
+
+
+
+ssize_t sketch_read(int cpu, struct iov_iter *to, loff_t *off)
+{
+    /*
+     * read history of core with id @cpu as array of struct mat_sketch_epoch,
+     * oldest epoch first. the offset @off refers to the bytes of the array,
+     * i.e., the history is seekable; epochs ending while reading shift it.
+     */
+    const struct sketch_history* history;
+    ssize_t result = 0;
+    u64 first;
+    u64 bytes;
+
+    /* make sure that selected CPU @cpu is valid */
+    if(!utilities_cpu_valid(cpu))
+    {
+        MAT_MERR_FUNC( "cpu=%d", cpu );
+        return -EFAULT;
+    }
+
+    mutex_lock(&gm_sketch_mutex);
+    if(!gm_sketch_histories || !gm_sketch_histories[cpu].epochs)
+    {
+        result = -ENODATA; goto exit;
+    }
+    history = &(gm_sketch_histories[cpu]);
+    first = (history->num > gm_sketch_history) ? history->num - gm_sketch_history : 0;
+    bytes = (history->num - first) * sizeof(struct mat_sketch_epoch);
+    /* copy entries in parts if read is not aligned */
+    while(*off < bytes && iov_iter_count(to))
+    {
+        const u64 idx = div_u64(*off, sizeof(struct mat_sketch_epoch));
+        const size_t begin = *off - idx * sizeof(struct mat_sketch_epoch);
+        const size_t len = min(sizeof(struct mat_sketch_epoch) - begin, iov_iter_count(to));
+        u32 slot;
+        div_u64_rem(first + idx, gm_sketch_history, &slot);
+        if(copy_to_iter((char*)&(history->epochs[slot]) + begin, len, to) != len)
+        {
+            MAT_MERR_FUNC( "len=%ld off=%lld", len, *off );
+            result = result ? result : -EFAULT; goto exit;
+        }
+        *off   += len;
+        result += len;
+    }
+    MAT_MDBG_FUNC( "cpu=%d len=%ld off=%lld", cpu, result, *off );
+exit:
+    mutex_unlock(&gm_sketch_mutex);
+    return result;
+}
+#endif /* MAT_ADDR_SKETCH */
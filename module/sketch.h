@@ -0,0 +1,36 @@
+#ifndef _MAT_SKETCH_H
+#define _MAT_SKETCH_H
+
+#include <linux/mat.h>
+#include <linux/uio.h> /* iov_iter */
+
+#ifdef MAT_ADDR_SKETCH
+/*
+ * entry of the history of sketches of a core, one per epoch.
+ * DEVICE_PATH"_sketch_cpu<X>" reads the history of core X as array of
+ * entries, oldest first (at most "sketch_history" epochs).
+ * @seq: number of epoch since enabling sketches (same for all cores)
+ * @start, @end: begin and end of epoch (CLOCK_MONOTONIC, ns)
+ * @samples: samples of core with address != 0x0
+ * @lines, @pages: estimated number of distinct cache lines (64 B) and pages (4 KiB)
+ * @top_pages: page numbers (address >> 12) of highest estimated count, sorted
+ * @top_counts: estimated samples of @top_pages (may overestimate), 0: unused
+ */
+struct mat_sketch_epoch
+{
+    u64 seq;
+    u64 start;
+    u64 end;
+    u64 samples;
+    u64 lines;
+    u64 pages;
+    u64 top_pages[MAT_SKETCH_TOPK];
+    u64 top_counts[MAT_SKETCH_TOPK];
+};
+
+int sketch_setup_devattr(void);
+void sketch_reset(void);
+ssize_t sketch_read(int cpu, struct iov_iter *to, loff_t *off);
+#endif /* MAT_ADDR_SKETCH */
+
+#endif /* _MAT_SKETCH_H */
@@ -0,0 +1,193 @@
+#include "stats.h"
+
+#include <linux/device.h>  /* device (attriutes) */
+#include <linux/sysfs.h>   /* bin_attribute */
+#include <linux/cpumask.h> /* nr_cpu_ids, cpu_possible, cpu_online */
+#include <linux/slab.h>    /* kmalloc, kfree */
+#include <linux/rcupdate.h>
+
+#include "utilities.h"
+
+
+
+static loff_t stats_bytes(void)
+{
+    return sizeof(struct mat_stats_header) + (loff_t)nr_cpu_ids * sizeof(struct mat_stats_cpu);
+}
+
+
+
+static void stats_header(struct mat_stats_header* header)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic        = MAT_STATS_MAGIC;
+    header->version      = MAT_STATS_VERSION;
+    header->header_bytes = sizeof(struct mat_stats_header);
+    header->cpu_bytes    = sizeof(struct mat_stats_cpu);
+    header->cpus         = nr_cpu_ids;
+    header->buf_num      = MAT_STATS_BUF_NUM;
+    header->ranges       = MAT_STATS_RANGES;
+}
+
+
+
+#ifdef MAT_ADDR_RANGE_COUNTERS
+static void stats_cpu(struct mat_stats_cpu* stats, int cpu, struct mat_ranges* ranges)
+#else /* MAT_ADDR_RANGE_COUNTERS */
+static void stats_cpu(struct mat_stats_cpu* stats, int cpu)
+#endif /* MAT_ADDR_RANGE_COUNTERS */
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->cpu = cpu;
+    if(!cpu_possible(cpu))
+    {
+        return;
+    }
+    stats->flags |= MAT_STATS_POSSIBLE;
+    stats->flags |= cpu_online(cpu)                  ? MAT_STATS_ONLINE : 0;
+    stats->flags |= cpumask_test_cpu(cpu, &gm_cpumask) ? MAT_STATS_TRACED : 0;
+
+#ifdef MAT_ADDR_BUFFERS
+    {
+        const struct mat_buffers* buffers = per_cpu_ptr(&cpu_mat_buffers, cpu);
+        u32 idx;
+        stats->buf_idx = buffers->buf_idx;
+        for(idx=0; idx<MAT_BUF_NUM; idx++)
+        {
+            stats->capacity[idx] = buffers->buffers[idx].capacity;
+            stats->size[idx]     = buffers->buffers[idx].size;
+        }
+        stats->accepted = buffers->accepted;
+        stats->dropped  = buffers->dropped;
+        stats->zero     = buffers->zero;
+    }
+#endif /* MAT_ADDR_BUFFERS */
+
+#if defined(MAT_FILTER_TASK) || defined(MAT_FILTER_ADDR) || defined(MAT_FILTER_MEM)
+    {
+        const struct mat_filter_cnts* cnts = per_cpu_ptr(&cpu_mat_filter_cnts, cpu);
+        stats->rejected_task = cnts->task;
+        stats->rejected_addr = cnts->addr;
+        stats->rejected_mem  = cnts->mem;
+    }
+#endif /* MAT_FILTER_TASK || MAT_FILTER_ADDR || MAT_FILTER_MEM */
+
+#ifdef MAT_ADDR_HASH_TABLE
+    {
+        const struct mat_hash_table* table = per_cpu_ptr(&cpu_mat_hash_tables, cpu);
+        stats->hash_samples = table->samples;
+        stats->hash_evicted = table->evicted;
+    }
+#endif /* MAT_ADDR_HASH_TABLE */
+
+#ifdef MAT_ADDR_RANGE_COUNTERS
+    if(ranges)
+    {
+        const u64* cnts = per_cpu_ptr(ranges->cnts, cpu);
+        u32 idx;
+        stats->ranges_num = ranges->num + 1;
+        for(idx=0; idx<stats->ranges_num; idx++)
+        {
+            stats->ranges[idx] = cnts[idx];
+        }
+    }
+#endif /* MAT_ADDR_RANGE_COUNTERS */
+}
+
+
+
+/*
+ * binary attribute with statistics of every core (see struct mat_stats_header).
+ * the file is seekable, a read may start and end within an entry.
+ */
+static ssize_t bin_attr_stats_read(struct file *file, struct kobject *kobj, struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+    const loff_t bytes = stats_bytes();
+    struct mat_stats_cpu* stats;
+#ifdef MAT_ADDR_RANGE_COUNTERS
+    struct mat_ranges* ranges;
+#endif /* MAT_ADDR_RANGE_COUNTERS */
+    size_t done;
+
+    if(off >= bytes)
+    {
+        return 0;
+    }
+    if(count > bytes - off)
+    {
+        count = bytes - off;
+    }
+
+    /* entry of a single core (or header), copied in parts if read is not aligned */
+    BUILD_BUG_ON(sizeof(struct mat_stats_header) > sizeof(struct mat_stats_cpu));
+    stats = kmalloc(sizeof(*stats), GFP_KERNEL);
+    if(!stats)
+    {
+        return -ENOMEM;
+    }
+#ifdef MAT_ADDR_BUFFERS
+    BUILD_BUG_ON(MAT_BUF_NUM != MAT_STATS_BUF_NUM);
+#endif /* MAT_ADDR_BUFFERS */
+#ifdef MAT_ADDR_RANGE_COUNTERS
+    BUILD_BUG_ON(MAT_RANGE_BOUNDS + 1 != MAT_STATS_RANGES);
+    rcu_read_lock();
+    ranges = rcu_dereference(gk_mat_ranges);
+#endif /* MAT_ADDR_RANGE_COUNTERS */
+
+    done = 0;
+    while(done < count)
+    {
+        const loff_t pos = off + done;
+        size_t begin;
+        size_t len;
+        if(pos < sizeof(struct mat_stats_header))
+        {
+            stats_header( (struct mat_stats_header*)stats );
+            begin = pos;
+            len   = sizeof(struct mat_stats_header) - begin;
+        }
+        else
+        {
+            const loff_t entry = pos - sizeof(struct mat_stats_header);
+            const int cpu = div_u64(entry, sizeof(struct mat_stats_cpu));
+#ifdef MAT_ADDR_RANGE_COUNTERS
+            stats_cpu(stats, cpu, ranges);
+#else /* MAT_ADDR_RANGE_COUNTERS */
+            stats_cpu(stats, cpu);
+#endif /* MAT_ADDR_RANGE_COUNTERS */
+            begin = entry - (loff_t)cpu * sizeof(struct mat_stats_cpu);
+            len   = sizeof(struct mat_stats_cpu) - begin;
+        }
+        len = min(len, count - done);
+        memcpy(buf + done, (char*)stats + begin, len);
+        done += len;
+    }
+
+#ifdef MAT_ADDR_RANGE_COUNTERS
+    rcu_read_unlock();
+#endif /* MAT_ADDR_RANGE_COUNTERS */
+    kfree(stats);
+    MAT_MDBG_FUNC( "off=%lld count=%ld", off, count );
+    return count;
+}
+/* create binary attribute bin_attr_<name>, size is set on setup */
+static BIN_ATTR(stats, S_IRUSR, bin_attr_stats_read, NULL, 0);
+
+
+
+/*
+ * setup binary attribute with statistics of every core
+ */
+int stats_setup_devattr(void)
+{
+    int rval;
+    bin_attr_stats.size = stats_bytes();
+    rval = device_create_bin_file(gm_device, &bin_attr_stats);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", bin_attr_stats.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s (%ld bytes)", bin_attr_stats.attr.name, bin_attr_stats.size );
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef _MAT_STATS_H
+#define _MAT_STATS_H
+
+#include <linux/mat.h>
+
+/*
+ * layout of binary attribute "stats": a header followed by one entry
+ * per CPU id (0 to @cpus-1), i.e., statistics of all cores in a single read.
+ * ids that are not possible CPUs have @flags 0 and all counters 0.
+ * counters of features not compiled into kernel/module are 0.
+ * values of a core are a snapshot without locking, the producer may
+ * update them while they are read.
+ */
+#define MAT_STATS_MAGIC   (0x544154535f54414dull) /* "MAT_STAT" in little endian */
+#define MAT_STATS_VERSION 1
+/* layout is fixed, i.e., does not depend on kernel configuration */
+#define MAT_STATS_BUF_NUM 2  /* MAT_BUF_NUM */
+#define MAT_STATS_RANGES  65 /* MAT_RANGE_BOUNDS + 1 */
+/* @flags of an entry */
+#define MAT_STATS_POSSIBLE (1 << 0)
+#define MAT_STATS_ONLINE   (1 << 1)
+#define MAT_STATS_TRACED   (1 << 2) /* core in "cpus" */
+struct mat_stats_header
+{
+    u64 magic;
+    u32 version;
+    u32 header_bytes;
+    u32 cpu_bytes;
+    u32 cpus;
+    u32 buf_num;
+    u32 ranges;
+};
+struct mat_stats_cpu
+{
+    s32 cpu;
+    u32 flags;
+    /* index of active buffer and number of used range counters */
+    u32 buf_idx;
+    u32 ranges_num;
+    /* u64 elements per buffer */
+    u64 capacity[MAT_STATS_BUF_NUM];
+    u64 size[MAT_STATS_BUF_NUM];
+    /* samples of buffers (see struct mat_buffers) */
+    u64 accepted;
+    u64 dropped;
+    u64 zero;
+    /* samples rejected by filters */
+    u64 rejected_task;
+    u64 rejected_addr;
+    u64 rejected_mem;
+    /* samples counted by and lost in hash table */
+    u64 hash_samples;
+    u64 hash_evicted;
+    /* samples per address range */
+    u64 ranges[MAT_STATS_RANGES];
+};
+
+int stats_setup_devattr(void);
+
+#endif /* _MAT_STATS_H */
@@ -0,0 +1,201 @@
+#include "strides.h"
+
+#include <linux/device.h>  /* device (attriutes) */
+#include <linux/cpumask.h> /* for_each_cpu */
+#include <linux/slab.h>    /* kzalloc, kfree */
+
+#include "utilities.h"
+
+#ifdef MAT_ADDR_STRIDES
+/* upper bounds of ranges 0 to MAT_STRIDE_RANGES-2, same ranges as mat_addr_range */
+static const u64 gm_stride_bounds[MAT_STRIDE_RANGES - 1] = {
+    0x0ull, 0x40000000ull, 0x7d0000000000ull, 0x7ff000000000ull, 0xfff000000000000ull
+};
+
+
+
+static void strides_clear(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        memset(per_cpu_ptr(&cpu_mat_strides, cpu), 0, sizeof(struct mat_strides));
+    }
+}
+
+
+
+/* add histograms of selected cores (see "cpu") to @sum */
+static void strides_sum(struct mat_strides* sum)
+{
+    int cpu;
+    u32 range;
+    u32 idx;
+
+    for_each_cpu(cpu, &gm_cpus_selected)
+    {
+        const struct mat_strides* strides = per_cpu_ptr(&cpu_mat_strides, cpu);
+        for(range=0; range<MAT_STRIDE_RANGES; range++)
+        {
+            for(idx=0; idx<MAT_STRIDE_BUCKETS; idx++)
+            {
+                sum->forward[range][idx]  += strides->forward[range][idx];
+                sum->backward[range][idx] += strides->backward[range][idx];
+            }
+            for(idx=0; idx<2*MAT_STRIDE_LINES+1; idx++)
+            {
+                sum->lines[range][idx] += strides->lines[range][idx];
+            }
+        }
+    }
+}
+
+
+
+/*
+ * device attribute functions for managing histograms of address deltas
+ */
+static ssize_t dev_attr_strides_enabled_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%d\n", gk_mat_strides_enabled);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_strides_enabled_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0 && tmp != 1)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld tmp=%d", count, tmp );
+    WRITE_ONCE(gk_mat_strides_enabled, tmp);
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(strides_enabled, S_IRUSR | S_IWUSR, dev_attr_strides_enabled_show, dev_attr_strides_enabled_store);
+
+static ssize_t dev_attr_strides_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    /*
+     * per range with deltas: exact strides of -MAT_STRIDE_LINES to
+     * MAT_STRIDE_LINES cache lines (non-zero only) and one line per
+     * non-empty log2 bucket of |delta| in bytes, forward and backward,
+     * summed over selected cores (see "cpu").
+     */
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    struct mat_strides* sum;
+    u32 range;
+    u32 idx;
+
+    sum = kzalloc(sizeof(struct mat_strides), GFP_KERNEL);
+    if(!sum)
+    {
+        return -ENOMEM;
+    }
+    strides_sum(sum);
+
+    for(range=1; range<MAT_STRIDE_RANGES; range++)
+    {
+        u64 deltas = 0;
+        for(idx=0; idx<MAT_STRIDE_BUCKETS; idx++)
+        {
+            deltas += sum->forward[range][idx] + sum->backward[range][idx];
+        }
+        if(!deltas)
+        {
+            continue;
+        }
+        if(range == MAT_STRIDE_RANGES - 1)
+        {
+            MAT_WRITE_BUF("range %u (> 0x%llx): %lld deltas\n", range, gm_stride_bounds[range-1], deltas);
+        }
+        else
+        {
+            MAT_WRITE_BUF("range %u (> 0x%llx, <= 0x%llx): %lld deltas\n", range, gm_stride_bounds[range-1], gm_stride_bounds[range], deltas);
+        }
+        MAT_WRITE_BUF(" lines:");
+        for(idx=0; idx<2*MAT_STRIDE_LINES+1; idx++)
+        {
+            if(sum->lines[range][idx])
+            {
+                MAT_WRITE_BUF(" %+d:%lld", (int)idx - MAT_STRIDE_LINES, sum->lines[range][idx]);
+            }
+        }
+        MAT_WRITE_BUF("\n %6s | %20s | %16s | %16s\n", "bucket", ">= |delta|", "forward", "backward");
+        for(idx=0; idx<MAT_STRIDE_BUCKETS; idx++)
+        {
+            if(sum->forward[range][idx] || sum->backward[range][idx])
+            {
+                MAT_WRITE_BUF(" %6u | %20llu | %16lld | %16lld\n",
+                    idx, idx ? 1ull << (idx - 1) : 0, sum->forward[range][idx], sum->backward[range][idx]);
+            }
+        }
+    }
+    if( buf == buf_begin )
+    {
+        MAT_WRITE_BUF( "%d\n", 0);
+    }
+
+    kfree(sum);
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_strides_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /* "0": reset histograms and previous addresses of every core */
+    int tmp;
+
+    tmp = -1;
+    sscanf(buf, "%d", &tmp);
+    if(tmp != 0)
+    {
+        return -EINVAL;
+    }
+    MAT_MDBG_FUNC( "count=%ld", count );
+    strides_clear();
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(strides, S_IRUSR | S_IWUSR, dev_attr_strides_show, dev_attr_strides_store);
+
+
+
+/*
+ * setup device attributes for managing histograms of address deltas
+ */
+int strides_setup_devattr(void)
+{
+    int rval;
+    rval = device_create_file(gm_device, &dev_attr_strides_enabled);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_strides_enabled.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_strides_enabled.attr.name );
+
+    rval = device_create_file(gm_device, &dev_attr_strides);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_strides.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_strides.attr.name );
+    return 0;
+}
+
+
+
+void strides_reset(void)
+{
+    WRITE_ONCE(gk_mat_strides_enabled, 0);
+    strides_clear();
+}
+#endif /* MAT_ADDR_STRIDES */
@@ -0,0 +1,11 @@
+#ifndef _MAT_STRIDES_H
+#define _MAT_STRIDES_H
+
+#include <linux/mat.h>
+
+#ifdef MAT_ADDR_STRIDES
+int strides_setup_devattr(void);
+void strides_reset(void);
+#endif /* MAT_ADDR_STRIDES */
+
+#endif /* _MAT_STRIDES_H */
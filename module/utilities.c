@@ -4,6 +4,8 @@
 /* global variables */
 struct device *gm_device = NULL;
 int gm_cpu = -1;
+struct cpumask gm_cpus_selected;
+struct cpumask gm_cpumask;
 
 #ifdef MAT_MODULE_DEBUG
 int gm_module_debug = 0;
@@ -144,42 +146,86 @@ static ssize_t dev_attr_cpu_show(struct device *dev, struct device_attribute *at
     {
         MAT_WRITE_BUF( "%d\n", gm_cpu);
     }
+    else if(!cpumask_equal(&gm_cpus_selected, cpu_possible_mask))
+    {
+        MAT_WRITE_BUF( "%*pbl\n", cpumask_pr_args(&gm_cpus_selected));
+    }
 
     MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
     return (buf - buf_begin);
 }
 static ssize_t dev_attr_cpu_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-    /* possible input are -1 (all cpus) or [0, CPUS-1] */
-    const int CPUS = num_online_cpus();
+    /*
+     * possible input are -1 or nothing (all cpus), a cpu id or a
+     * cpulist (e.g., "0-15,32-47"). detailed views need a single cpu.
+     */
+    struct cpumask mask;
     int arg;
-    ssize_t tmp;
 
     MAT_MDBG_FUNC( "count=%ld", count );
 
-    tmp = sscanf(buf, "%d", &arg);
-    if(tmp < 1 || tmp > 2)
+    if(sysfs_streq(buf, "-1") || sysfs_streq(buf, ""))
     {
-        return -EINVAL;
+        gm_cpu = -1;
+        cpumask_copy(&gm_cpus_selected, cpu_possible_mask);
+        return count;
     }
-
-    if(arg < -1 || arg >= CPUS)
+    if(cpulist_parse(buf, &mask) || cpumask_empty(&mask) || !cpumask_subset(&mask, cpu_possible_mask))
     {
         return -EINVAL;
     }
+    arg = -1;
+    if(cpumask_weight(&mask) == 1)
+    {
+        arg = cpumask_first(&mask);
+    }
     gm_cpu = arg;
+    cpumask_copy(&gm_cpus_selected, &mask);
 
-    MAT_MDBG_FUNC( "count=%ld arg=%d tmp=%ld gm_cpu=%d", count, arg, tmp, gm_cpu );
+    MAT_MDBG_FUNC( "count=%ld gm_cpu=%d selected=%*pbl", count, gm_cpu, cpumask_pr_args(&gm_cpus_selected) );
     return count;
 }
 /* create device attribute dev_attr_<name> */
 static DEVICE_ATTR(cpu, S_IRUSR | S_IWUSR, dev_attr_cpu_show, dev_attr_cpu_store);
 
+static ssize_t dev_attr_cpus_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const char* const buf_begin = buf; /* used by MAT_WRITE_BUF */
+    bool  buf_full = false;            /* used by MAT_WRITE_BUF */
+    MAT_WRITE_BUF( "%*pbl\n", cpumask_pr_args(&gm_cpumask));
+    MAT_MDBG_FUNC( "bytes=%ld", (buf - buf_begin) );
+    return (buf - buf_begin);
+}
+static ssize_t dev_attr_cpus_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    /*
+     * cpulist of traced cores (e.g., "0-15,32-47"), samples of other cores
+     * are ignored. applies to buffers and hash tables allocated afterwards.
+     */
+    struct cpumask mask;
+
+    if(cpulist_parse(buf, &mask) || cpumask_empty(&mask) || !cpumask_subset(&mask, cpu_possible_mask))
+    {
+        return -EINVAL;
+    }
+    cpumask_copy(&gm_cpumask, &mask);
+#ifdef MAT_CPUMASK
+    cpumask_copy(&gk_mat_cpumask, &mask);
+#endif /* MAT_CPUMASK */
+    MAT_MDBG_FUNC( "count=%ld cpus=%*pbl", count, cpumask_pr_args(&gm_cpumask) );
+    return count;
+}
+/* create device attribute dev_attr_<name> */
+static DEVICE_ATTR(cpus, S_IRUSR | S_IWUSR, dev_attr_cpus_show, dev_attr_cpus_store);
+
 
 
 int utilities_setup_devattr(void)
 {
     int rval = 0;
+    cpumask_copy(&gm_cpus_selected, cpu_possible_mask);
+    cpumask_copy(&gm_cpumask, cpu_possible_mask);
     rval = device_create_file(gm_device, &dev_attr_cpu);
     if (rval < 0)
     {
@@ -188,6 +234,14 @@ int utilities_setup_devattr(void)
     }
     MAT_MDBG_FUNC( "created %s", dev_attr_cpu.attr.name );
 
+    rval = device_create_file(gm_device, &dev_attr_cpus);
+    if (rval < 0)
+    {
+        MAT_MERR_FUNC( "failed to create %s", dev_attr_cpus.attr.name );
+        return -1;
+    }
+    MAT_MDBG_FUNC( "created %s", dev_attr_cpus.attr.name );
+
 #ifdef MAT_MODULE_DEBUG
     rval = device_create_file(gm_device, &dev_attr_module_debug);
     if (rval < 0)
@@ -212,6 +266,12 @@ int utilities_setup_devattr(void)
 
 void utilities_reset(void)
 {
+    gm_cpu = -1;
+    cpumask_copy(&gm_cpus_selected, cpu_possible_mask);
+    cpumask_copy(&gm_cpumask, cpu_possible_mask);
+#ifdef MAT_CPUMASK
+    cpumask_copy(&gk_mat_cpumask, cpu_possible_mask);
+#endif /* MAT_CPUMASK */
 #ifdef MAT_KERNEL_DEBUG_FLAG
     gk_mat_kernel_debug = 0;
 #endif /* MAT_KERNEL_DEBUG_FLAG */
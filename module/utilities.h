@@ -3,6 +3,7 @@
 
 #include <linux/module.h>
 #include <linux/device.h>
+#include <linux/cpumask.h>
 #include <linux/mat_config.h>
 
 #ifndef CLASS_NAME
@@ -16,8 +17,34 @@
 
 /* device used to register attributes for IO using sysfs */
 extern struct device *gm_device;
-/* selected CPU to change behavior of various functions */
+/* selected CPU to change behavior of various functions (-1: none or several) */
 extern int gm_cpu;
+/* cores selected by "cpu" (all if -1), summaries of per-core data show these */
+extern struct cpumask gm_cpus_selected;
+/* traced cores ("cpus"), only these get buffers and hash tables */
+extern struct cpumask gm_cpumask;
+
+/* CPU ids may be sparse, valid ids are possible CPUs (online or not) */
+static inline bool utilities_cpu_valid(int cpu)
+{
+    return cpu >= 0 && cpu < nr_cpu_ids && cpu_possible(cpu);
+}
+
+/*
+ * state of an opened device file (file->private_data).
+ * DEVICE_PATH reads core selected by @gm_cpu at the time of opening,
+ * DEVICE_PATH"_cpu<X>" always reads core X,
+ * DEVICE_PATH"_hash_cpu<X>" reads the hash table of core X,
+ * DEVICE_PATH"_sketch_cpu<X>" reads the history of sketches of core X.
+ */
+#define MAT_FILE_BUFFERS    0
+#define MAT_FILE_HASH_TABLE 1
+#define MAT_FILE_SKETCH     2
+struct mat_file
+{
+    int cpu;
+    int type;
+};
 
 #define MAT_MODULE_DEBUG // enable debugging in this module
 #ifdef MAT_MODULE_DEBUG
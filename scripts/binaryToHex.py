@@ -5,13 +5,35 @@ import mmap
 
 parser = argparse.ArgumentParser(description='Convert binary data to hexadecimal string (stdout): 8 bytes -> hex + \n')
 parser.add_argument('input', metavar='FILE', type=str, help='path to input file')
+parser.add_argument('--schema', metavar='SCHEMA', type=str, default='addr',
+                    help='fields of a record, i.e., content of buffers_schema (e.g., "addr tsc ip"); one record per line')
+parser.add_argument('--tags', action='store_true',
+                    help='addresses carry tags of events (buffers_tags): print tag and address instead of the first field')
 args = parser.parse_args()
+### tag in bits 57 to 63 of an address (little endian), address is restored by sign-extending bit 56
+TAG_SHIFT = 57
+def untag(b):
+    v = int.from_bytes(b, "little", signed=False)
+    addr = v & ((1 << TAG_SHIFT) - 1)
+    if addr & (1 << (TAG_SHIFT - 1)):
+        addr |= ((1 << 64) - 1) ^ ((1 << TAG_SHIFT) - 1)
+    return '{:d} 0x{:016x}'.format(v >> TAG_SHIFT, addr)
+### every field of a record is 8 bytes
+fields = len(args.schema.replace(',', ' ').split())
 with open(args.input, "r+b") as f:
     m = mmap.mmap(f.fileno(), 0)
     while True:
-        b = m.read(8)
-        if b == b'':
+        record = []
+        for i in range(fields):
+            b = m.read(8)
+            if b == b'':
+                break
+            if args.tags and i == 0:
+                record.append(untag(b))
+            else:
+                record.append('0x{:016x}'.format(int.from_bytes(b, "big", signed=False)))
+        if not record:
             break
-        print('0x{:016x}'.format(int.from_bytes(b, "big", signed=False)))
+        print(' '.join(record))
     m.close()
 
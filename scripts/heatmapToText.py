@@ -0,0 +1,54 @@
+#!/usr/bin/python3
+
+import argparse
+import struct
+
+parser = argparse.ArgumentParser(description='Print binary heatmap of kernel module (attribute "heatmap_matrix") as CSV: one line per address bucket, one column per time bucket')
+parser.add_argument('input', metavar='FILE', type=str, nargs='?',
+                    default='/sys/devices/virtual/memory_address_tracer/memory_address_tracer/heatmap_matrix',
+                    help='path to heatmap_matrix attribute or a copy of it (e.g., HEATMAP.bin)')
+parser.add_argument('--cpu', metavar='ID', type=int, default=-1, help='print heatmap of a single core (default: sum of all cores)')
+parser.add_argument('--info', action='store_true', help='print shape and samples per core only')
+args = parser.parse_args()
+
+### layout of struct mat_heatmap_header and struct mat_heatmap_cpu (module/heatmap.h, include/linux/mat.h)
+MAGIC = 0x544145485f54414d
+HEADER = struct.Struct('<QIIQQIIIIQIIIIQ')
+ENTRY = struct.Struct('<iIQQ')
+LOG = 1
+
+with open(args.input, 'rb') as f:
+    data = f.read()
+if len(data) < HEADER.size:
+    raise SystemExit('error: no heatmap in ' + args.input)
+(magic, version, header_bytes, amin, amax, scale, shift, rows, cols,
+ start, col_ms, cols_used, cpus, _, cpu_bytes) = HEADER.unpack_from(data, 0)
+if magic != MAGIC or version != 1:
+    raise SystemExit('error: unknown format of ' + args.input)
+
+def row_begin(row):
+    ### inverse of mat_heatmap_row: lowest address of row
+    if scale != LOG:
+        return amin + (row << shift)
+    if row < (1 << shift):
+        return amin + row
+    e, m = row >> shift, row & ((1 << shift) - 1)
+    return amin + (((1 << shift) + m) << (e - 1))
+
+total = [0] * (rows * cols)
+for i in range(cpus):
+    off = header_bytes + i * cpu_bytes
+    cpu, _, outside, late = ENTRY.unpack_from(data, off)
+    cnts = struct.unpack_from('<{}I'.format(rows * cols), data, off + ENTRY.size)
+    if args.info:
+        print('CPU {:3d}: samples={} outside={} late={}'.format(cpu, sum(cnts), outside, late))
+    if args.cpu < 0 or args.cpu == cpu:
+        total = [a + b for a, b in zip(total, cnts)]
+
+if args.info:
+    print('range=[0x{:x}, 0x{:x}) rows={} ({}, shift={}) cols={}/{} ({} ms)'.format(
+        amin, amax, rows, 'log' if scale == LOG else 'linear', shift, cols_used, cols, col_ms))
+else:
+    print('address,' + ','.join(str(c * col_ms / 1000) for c in range(cols_used)))
+    for r in range(rows):
+        print('0x{:x},'.format(row_begin(r)) + ','.join(str(total[c * rows + r]) for c in range(cols_used)))
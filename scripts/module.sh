@@ -17,20 +17,141 @@ COMMAND:
     showdebug                    Show debug information of kernel module.
     showsamples                  Show range counters.
     showsamplesall               Show range counters of all CPUs.
+    showstrides                  Show histograms of deltas between
+                                 consecutive addresses (--strides).
     showbuffers                  Show buffer statistics.
     showbuffersall               Show buffer statistics of all CPUs.
+    showstats                    Show statistics of all CPUs with a single
+                                 read of binary attribute stats.
     write                        Write all per-core buffers to disk.
+    writehash                    Write all per-core hash tables to disk.
+    showhash                     Show hash table statistics.
+    writesketch                  Write history of sketches of all cores to
+                                 disk (decode with sketchToText.py).
+    showsketch                   Show last epoch of sketches of all cores.
+    writeheatmap                 Write heatmap of all cores to disk
+                                 (HEATMAP.bin, decode with heatmapToText.py).
+    showheatmap                  Show shape and samples of heatmap.
+    showfilter                   Show samples rejected by filters.
+    showphyscache                Show hits/misses of translation caches
+                                 (--physical-address).
+    shownuma                     Show samples per NUMA node of every core
+                                 and socket (--numa).
+    writenuma                    Write CPU x node matrix to disk
+                                 (NUMA.bin, layout in module/numa.h).
+    showhist                     Show histograms of cycles per sample and
+                                 per PMI and of samples per PMI (--hist)
+                                 and scaled sample periods (--budget).
+    stream                       Stream all per-core buffers to disk until
+                                 tracing is stopped (needs --stream).
+    stop                         Stop tracing; readers of stream finish,
+                                 sketches add their last (partial) epoch,
+                                 the heatmap stops advancing.
 
 Options:
     -h, --help                    Show help message and exit.
     -p, --physical-address        Set up profiling of physical address
                                   instead of virtual address.
+    --phys-cache-age <ms>         Cache page translations of physical
+                                  addresses for at most <ms> ms (default:
+                                  10, 0 disables cache).
+    --numa                        Count samples per NUMA node of physical
+                                  address per core (needs -p).
     -s, --buffer-size <size>      Set size of per-core address buffers.
+    -C, --cpus <cpulist>          Trace and allocate buffers only on cores of
+                                  <cpulist>, e.g., 0-3,8-11 (default: all).
+    --hugepages                   Back per-core buffers with 2 MiB pages
+                                  (if available on node of core).
+    --pool <size>                 Instead of per-core buffers, let cores take
+                                  2 MiB chunks of a pool of <size> bytes.
+    --hist                        Record histograms of tracing overhead.
+    --no-batch                    Process every large PEBS record with its
+                                  own perf sample (no batches from DS buffer).
+    --budget <percent>            Scale sample period per core, so that at
+                                  most <percent> of time is spent in PMI
+                                  handler (e.g., 2; 0 disables, default).
+    -S, --stream                  Set up per-core buffers as ring buffers
+                                  that are read while tracing.
+    -P, --policy <policy>         Set policy if per-core buffers are full:
+                                  stop (default), overwrite (keep newest
+                                  samples), reservoir (uniform sample).
+    -E, --encoding <encoding>     Set encoding of addresses in per-core
+                                  buffers: raw (default), varint (delta +
+                                  varint, decode with varintToBinary).
+    -R, --record <fields>         Store records of address and fields
+                                  (comma separated) in per-core buffers:
+                                  tsc, ip, tid, weight, data_src, period.
+    -T, --tags <configs>          Tag addresses in per-core buffers with the
+                                  event of the sample: n-th config (comma
+                                  separated, e.g., 0x81d0,0x82d0) is tag n.
+    -H, --hash-table <entries>    Count samples per page in per-core hash
+                                  tables with <entries> entries.
+    --hash-shift <shift>          Set key of hash tables to address >> shift
+                                  (default: 12, i.e., 4 KiB pages).
+    --sketch <ms>                 Estimate distinct cache lines and pages and
+                                  hot pages per core in epochs of <ms> ms.
+    --sketch-history <epochs>     Keep last <epochs> epochs per core
+                                  (default: 256).
+    --heatmap <ms>                Count samples per time bucket of <ms> ms and
+                                  address bucket in per-core heatmaps.
+    --heatmap-cols <cols>         Number of time buckets (default: 3600).
+    --heatmap-rows <rows>         Maximum number of address buckets
+                                  (default: 1024).
+    --heatmap-range <min>:<max>   Address range of rows (default: 0:0x800000000000).
+    --heatmap-log                 Address buckets grow with distance to min.
+    -t, --tgids <tgids>           Keep only samples of processes with these
+                                  ids (comma separated).
+    -c, --children                Keep samples of child processes of --tgids.
+    -g, --cgroup <path>           Keep only samples of tasks in cgroup (v2)
+                                  <path>, e.g., /system.slice/db.service.
+    -a, --addr-filter <intervals> Keep all (1), 1 in N (N) or no (0) samples of
+                                  address intervals start:end:ratio (comma
+                                  separated, e.g., 0x7ffc00000000:0x800000000000:0).
+    -m, --mem-level <level>       Keep only loads of level all (default), l3miss
+                                  or remote (DRAM), needs perf mem record.
+    -w, --min-weight <cycles>     Keep only loads with latency >= cycles, needs
+                                  perf record --weight.
+    -r, --ranges <bounds>         Set upper boundaries of range counters
+                                  (sorted, comma separated, e.g.,
+                                  0x40000000,0x7f0000000000) or "default".
+    --strides                     Count deltas between consecutive addresses
+                                  per core and range (log2 buckets and
+                                  exact strides of up to 8 cache lines).
 EOF
 }
 
 ### parse command line arguments
 phys_addr=
+phys_cache_age=10
+numa=0
+stream=0
+hugepages=0
+pool_bytes=0
+policy="stop"
+encoding="raw"
+record="0"
+tags=""
+hash_entries=0
+hash_shift=12
+sketch_epoch=0
+sketch_history=256
+heatmap_ms=0
+heatmap_cols=3600
+heatmap_rows=1024
+heatmap_range="0:0x800000000000"
+heatmap_scale="linear"
+ranges="default"
+strides=0
+tgids=""
+children=0
+cgroup=""
+addr_filter=""
+mem_level="all"
+min_weight=0
+cpus=""
+hist=0
+budget=0
+pebs_batch=1
 cmd="showconfig"
 buffer_bytes="$((2**30))" ### 1GiB buffer per core
 
@@ -44,13 +165,156 @@ while [ "$#" -gt 0 ]; do
         phys_addr="true"
         shift
         ;;
+    --numa)
+        numa=1
+        shift
+        ;;
+    --phys-cache-age)
+        phys_cache_age="$2"
+        shift
+        shift
+        ;;
+    -P|--policy)
+        policy="$2"
+        shift
+        shift
+        ;;
+    -E|--encoding)
+        encoding="$2"
+        shift
+        shift
+        ;;
+    -R|--record)
+        record="$2"
+        shift
+        shift
+        ;;
+    -T|--tags)
+        tags="$2"
+        shift
+        shift
+        ;;
+    --sketch)
+        sketch_epoch="$2"
+        shift
+        shift
+        ;;
+    --sketch-history)
+        sketch_history="$2"
+        shift
+        shift
+        ;;
+    --heatmap)
+        heatmap_ms="$2"
+        shift
+        shift
+        ;;
+    --heatmap-cols)
+        heatmap_cols="$2"
+        shift
+        shift
+        ;;
+    --heatmap-rows)
+        heatmap_rows="$2"
+        shift
+        shift
+        ;;
+    --heatmap-range)
+        heatmap_range="$2"
+        shift
+        shift
+        ;;
+    --heatmap-log)
+        heatmap_scale="log"
+        shift
+        ;;
+    -H|--hash-table)
+        hash_entries="$(numfmt --from=auto $2)"
+        shift
+        shift
+        ;;
+    -t|--tgids)
+        tgids="$2"
+        shift
+        shift
+        ;;
+    -c|--children)
+        children=1
+        shift
+        ;;
+    -g|--cgroup)
+        cgroup="$2"
+        shift
+        shift
+        ;;
+    -a|--addr-filter)
+        addr_filter="$2"
+        shift
+        shift
+        ;;
+    -m|--mem-level)
+        mem_level="$2"
+        shift
+        shift
+        ;;
+    -w|--min-weight)
+        min_weight="$2"
+        shift
+        shift
+        ;;
+    --strides)
+        strides=1
+        shift
+        ;;
+    -r|--ranges)
+        ranges="$2"
+        shift
+        shift
+        ;;
+    --hash-shift)
+        hash_shift="$2"
+        shift
+        shift
+        ;;
+    -S|--stream)
+        stream=1
+        shift
+        ;;
+    -C|--cpus)
+        cpus="$2"
+        shift
+        shift
+        ;;
+    --hist)
+        hist=1
+        shift
+        ;;
+    --no-batch)
+        pebs_batch=0
+        shift
+        ;;
+    --budget)
+        ### percent to 1/10000
+        budget="$(awk -v p="$2" 'BEGIN { printf "%d", p * 100 }')"
+        shift
+        shift
+        ;;
+    --hugepages)
+        hugepages=1
+        shift
+        ;;
+    --pool)
+        pool_bytes="$(numfmt --from=auto $2)"
+        shift
+        shift
+        ;;
     -s|--buffer-size)
         ### parse size with suffix to bytes
         buffer_bytes="$(numfmt --from=auto $2)"
         shift
         shift
         ;;
-    set|reset|showconfig|showdebug|showsamples|showsamplesall|showbuffers|showbuffersall|write)
+    set|reset|showconfig|showdebug|showsamples|showsamplesall|showstrides|showbuffers|showbuffersall|showstats|write|writehash|showhash|writesketch|showsketch|writeheatmap|showheatmap|showfilter|showphyscache|shownuma|writenuma|showhist|stream|stop)
         cmd="$1"
         shift
         break
@@ -65,6 +329,16 @@ done
 ### divide by byte size of an address and by number of buffers we allocate per core
 buffer_size="$(($buffer_bytes / 8 / 2))"
 
+### expand cpulist (e.g., 0-3,8) of traced cores to one id per line,
+### ids may be sparse and are not bounded by nproc
+function traced_cpus() {
+    local list="$(seq 0 1 $(($(nproc)-1)) | paste -s -d ,)"
+    [[ -f $module_path/cpus ]] && list="$(cat $module_path/cpus)"
+    echo "$list" | tr ',' '\n' | while IFS=- read first last; do
+        [[ -n "$first" ]] && seq $first ${last:-$first}
+    done
+}
+
 if [[ "$EUID" -ne 0 ]]; then
     echo "error: no root rights"
     echo "run as root"
@@ -73,7 +347,7 @@ fi
 
 ### check that kernel module is loaded and IO files are available
 mod_files="get_addr perf_force_lpebs perf_no_throttling samples samples_total"
-mod_files+=" samples_total_nz buffers buffers_enabled cpu buffers_bytes phys_addr"
+mod_files+=" samples_total_nz buffers buffers_enabled cpu buffers_bytes phys_addr buffers_policy"
 for f in $mod_files
 do
     if [[ ! -f $module_path/$f ]]; then
@@ -91,17 +365,42 @@ fi
 if [[ "$cmd" == "reset" ]]; then
     echo 100000 > /proc/sys/kernel/perf_event_max_sample_rate
     echo 25 > /proc/sys/kernel/perf_cpu_time_max_percent
-    for f in buffers_enabled perf_no_throttling perf_force_lpebs module_debug kernel_debug phys_addr samples buffers get_addr
+    for f in adapt_budget adapt hist_enabled hist buffers_enabled buffers_pool buffers_stream buffers_encoding buffers_schema buffers_policy buffers_hugepages hash_enabled hash_table sketch_enabled sketch heatmap_enabled heatmap numa_enabled numa strides_enabled strides perf_no_throttling perf_force_lpebs pebs_batch pebs_batched module_debug kernel_debug phys_addr samples buffers get_addr
     do
         [[ -f $module_path/$f ]] && echo 0 > $module_path/$f
     done
     [[ -f $module_path/cpu ]] && echo -1 > $module_path/cpu
+    [[ -f $module_path/phys_cache_age ]] && echo 10 > $module_path/phys_cache_age
+    [[ -f $module_path/phys_cache ]] && echo 0 > $module_path/phys_cache
+    [[ -f $module_path/cpus ]] && cat /sys/devices/system/cpu/possible > $module_path/cpus
+    [[ -f $module_path/ranges ]] && echo default > $module_path/ranges
+    for f in filter_tgids filter_cgroup filter_addr
+    do
+        [[ -f $module_path/$f ]] && echo "" > $module_path/$f
+    done
+    [[ -f $module_path/buffers_tags ]] && echo "" > $module_path/buffers_tags
+    [[ -f $module_path/filter_children ]] && echo 0 > $module_path/filter_children
+    [[ -f $module_path/filter_mem_level ]] && echo all > $module_path/filter_mem_level
+    [[ -f $module_path/filter_mem_weight ]] && echo 0 > $module_path/filter_mem_weight
 elif [[ "$cmd" == "set" ]]; then
     echo 100000 > /proc/sys/kernel/perf_event_max_sample_rate
     echo 99 > /proc/sys/kernel/perf_cpu_time_max_percent
+    ### mode of buffers can only be switched while they are disabled
+    echo 0 > $module_path/buffers_enabled
+    [[ -f $module_path/buffers_encoding ]] && echo raw > $module_path/buffers_encoding
+    [[ -f $module_path/buffers_schema ]] && echo 0 > $module_path/buffers_schema
+    [[ -f $module_path/buffers_stream ]] && echo $stream > $module_path/buffers_stream
+    echo $policy > $module_path/buffers_policy
+    [[ -f $module_path/buffers_encoding ]] && echo $encoding > $module_path/buffers_encoding
+    [[ -f $module_path/buffers_schema ]] && echo $record > $module_path/buffers_schema
+    [[ -f $module_path/buffers_tags ]] && echo "$tags" > $module_path/buffers_tags
     echo 1 > $module_path/buffers_enabled
     echo 1 > $module_path/perf_no_throttling
     echo 1 > $module_path/perf_force_lpebs
+    if [[ -f $module_path/pebs_batch ]]; then
+        echo 0 > $module_path/pebs_batched
+        echo $pebs_batch > $module_path/pebs_batch
+    fi
     echo 0 > $module_path/module_debug
     echo 0 > $module_path/kernel_debug
     if [[ -z "$phys_addr" ]]; then
@@ -109,10 +408,83 @@ elif [[ "$cmd" == "set" ]]; then
     else
         echo 1 > $module_path/phys_addr
     fi
+    if [[ -f $module_path/phys_cache_age ]]; then
+        echo $phys_cache_age > $module_path/phys_cache_age
+        echo 0 > $module_path/phys_cache
+    fi
+    if [[ -f $module_path/numa ]]; then
+        echo 0 > $module_path/numa
+        echo $numa > $module_path/numa_enabled
+    fi
+    [[ -f $module_path/ranges ]] && echo $ranges > $module_path/ranges
+    if [[ -f $module_path/strides ]]; then
+        echo 0 > $module_path/strides
+        echo $strides > $module_path/strides_enabled
+    fi
+    if [[ -f $module_path/filter_tgids ]]; then
+        echo "$tgids" > $module_path/filter_tgids
+        echo $children > $module_path/filter_children
+        echo "$cgroup" > $module_path/filter_cgroup
+    fi
+    ### one interval "start end ratio" per line
+    [[ -f $module_path/filter_addr ]] && echo "$addr_filter" | tr ',:' '\n ' > $module_path/filter_addr
+    [[ -f $module_path/filter_mem_level ]] && echo $mem_level > $module_path/filter_mem_level
+    [[ -f $module_path/filter_mem_weight ]] && echo $min_weight > $module_path/filter_mem_weight
+    [[ -f $module_path/filter_rejected ]] && echo 0 > $module_path/filter_rejected
     echo 0 > $module_path/samples
+    if [[ -f $module_path/cpus ]]; then
+        ### buffers and hash tables are allocated only on traced cores
+        [[ -n "$cpus" ]] || cpus="$(cat /sys/devices/system/cpu/possible)"
+        echo 0 > $module_path/buffers
+        echo "$cpus" > $module_path/cpus
+    fi
     echo "allocate per-core buffer with $buffer_bytes bytes ($(numfmt --to=si $buffer_bytes))"
-    echo "$buffer_size" > $module_path/buffers
+    [[ -f $module_path/buffers_hugepages ]] && echo $hugepages > $module_path/buffers_hugepages
+    if [[ -f $module_path/buffers_pool ]]; then
+        ### pool can only be replaced while buffers are disabled
+        echo 0 > $module_path/buffers_enabled
+        echo 0 > $module_path/buffers_pool
+        if [[ "$pool_bytes" -gt 0 ]]; then
+            echo "allocate pool with $pool_bytes bytes ($(numfmt --to=si $pool_bytes))"
+            echo $pool_bytes > $module_path/buffers_pool
+        fi
+        echo 1 > $module_path/buffers_enabled
+    fi
+    [[ "$pool_bytes" -gt 0 ]] || echo "$buffer_size" > $module_path/buffers
     echo -1 > $module_path/cpu
+    if [[ -f $module_path/hash_table ]]; then
+        echo 0 > $module_path/hash_enabled
+        echo $hash_shift > $module_path/hash_shift
+        echo $hash_entries > $module_path/hash_table
+        [[ "$hash_entries" -gt 0 ]] && echo 1 > $module_path/hash_enabled
+    fi
+    if [[ -f $module_path/sketch ]]; then
+        echo 0 > $module_path/sketch
+        if [[ "$sketch_epoch" -gt 0 ]]; then
+            echo $sketch_epoch > $module_path/sketch_epoch
+            echo $sketch_history > $module_path/sketch_history
+            echo 1 > $module_path/sketch_enabled
+        fi
+    fi
+    if [[ -f $module_path/heatmap ]]; then
+        echo 0 > $module_path/heatmap
+        if [[ "$heatmap_ms" -gt 0 ]]; then
+            echo $heatmap_ms > $module_path/heatmap_ms
+            echo $heatmap_cols > $module_path/heatmap_cols
+            echo $heatmap_rows > $module_path/heatmap_rows
+            echo ${heatmap_range/:/ } > $module_path/heatmap_range
+            echo $heatmap_scale > $module_path/heatmap_scale
+            echo 1 > $module_path/heatmap_enabled
+        fi
+    fi
+    if [[ -f $module_path/hist ]]; then
+        echo 0 > $module_path/hist
+        echo $hist > $module_path/hist_enabled
+    fi
+    if [[ -f $module_path/adapt ]]; then
+        echo 0 > $module_path/adapt
+        echo $budget > $module_path/adapt_budget
+    fi
     echo 1 > $module_path/get_addr
 elif [[ "$cmd" == "showconfig" ]]; then
     for f in perf_event_max_sample_rate perf_cpu_time_max_percent
@@ -120,7 +492,7 @@ elif [[ "$cmd" == "showconfig" ]]; then
         file="/proc/sys/kernel/$f"
         printf "%-26s: %s\n" "$(basename $file)" "$(cat $file)"
     done
-    for f in buffers_enabled cpu get_addr kernel_debug perf_no_throttling perf_force_lpebs phys_addr samples_total samples_total_nz
+    for f in buffers_enabled buffers_stream buffers_watermark buffers_policy buffers_encoding buffers_schema buffers_tags buffers_hugepages hash_enabled hash_shift sketch_enabled sketch_epoch sketch_history heatmap_enabled heatmap_ms heatmap_cols heatmap_rows heatmap_range heatmap_scale filter_tgids filter_children filter_cgroup filter_addr filter_mem_level filter_mem_weight cpus cpu get_addr kernel_debug perf_no_throttling perf_force_lpebs pebs_batch phys_addr phys_cache_age numa_enabled strides_enabled hist_enabled adapt_budget adapt_window samples_total samples_total_nz
     do
         file="$module_path/$f"
         [[ -f "$file" ]] && printf "%-26s: %s\n" "$(basename $file)" "$(cat $file)"
@@ -131,34 +503,35 @@ elif [[ "$cmd" == "showdebug" ]]; then
 elif [[ "$cmd" == "showsamples" ]]; then
     file="$module_path/samples"
     [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "showstrides" ]]; then
+    file="$module_path/strides"
+    [[ -f "$file" ]] && cat $file
 elif [[ "$cmd" == "showsamplesall" ]]; then
     old="$(cat $module_path/cpu)"
     file="$module_path/samples"
-    ### show header
-    cat $file | head -n 4
-    ### show range counter for each CPU
-    for cpu in $(seq -s ' ' 0 1 $(($(nproc)-1)))
+    ### show range counters of every CPU (one table per CPU)
+    for cpu in $(traced_cpus)
     do
         echo $cpu > $module_path/cpu
-        tmp="$(cat $file)"
-        if [[ $(echo -e "$tmp" | wc -l ) -gt 2 ]]; then
-            echo -e "$tmp" | tail -n 1
-        fi
+        cat $file
     done
     echo $old > $module_path/cpu
 elif [[ "$cmd" == "showbuffers" ]]; then
     file="$module_path/buffers"
     [[ -f "$file" ]] && cat $file
+    [[ -f $module_path/buffers_pool ]] && grep -q chunks $module_path/buffers_pool && cat $module_path/buffers_pool
 elif [[ "$cmd" == "showbuffersall" ]]; then
     old="$(cat $module_path/cpu)"
-    for cpu in $(seq 0 1 $(($(nproc)-1)))
+    for cpu in $(traced_cpus)
     do
         [[ -f $module_path/buffers ]] && echo $cpu > $module_path/cpu && cat $module_path/buffers | grep CPU
     done
     echo $old > $module_path/cpu
+elif [[ "$cmd" == "showstats" ]]; then
+    python3 "$(dirname "$0")/statsToText.py" $module_path/stats
 elif [[ "$cmd" == "write" ]]; then
     old="$(cat $module_path/cpu)"
-    for cpu in $(seq 0 1 $(($(nproc)-1)))
+    for cpu in $(traced_cpus)
     do
         if [[ -f $module_path/buffers ]]; then
             echo $cpu > $module_path/cpu
@@ -166,11 +539,86 @@ elif [[ "$cmd" == "write" ]]; then
             if [[ "$available" -gt 0 ]]; then
                 ofile="$(printf "CPU%03d.bin" "$cpu")"
                 echo "writing $ofile ..."
-                head --bytes=$available $device_path > $ofile
+                ### drain every core with its own reader in parallel
+                head --bytes=$available ${device_path}_cpu${cpu} > $ofile &
             fi
         fi
     done
+    wait
+    ### readers need fields of records to decode them
+    [[ -f $module_path/buffers_schema ]] && cat $module_path/buffers_schema > schema.txt
+    [[ -f $module_path/buffers_tags ]] && cat $module_path/buffers_tags > tags.txt
     echo $old > $module_path/cpu
+elif [[ "$cmd" == "writehash" ]]; then
+    ### hash tables are arrays of (u64 key, u64 count), count 0 is empty
+    for cpu in $(traced_cpus)
+    do
+        ofile="$(printf "HASH%03d.bin" "$cpu")"
+        echo "writing $ofile ..."
+        cat ${device_path}_hash_cpu${cpu} > $ofile &
+    done
+    wait
+elif [[ "$cmd" == "writesketch" ]]; then
+    ### histories are arrays of struct mat_sketch_epoch (module/sketch.h), oldest first
+    for cpu in $(traced_cpus)
+    do
+        ofile="$(printf "SKETCH%03d.bin" "$cpu")"
+        echo "writing $ofile ..."
+        cat ${device_path}_sketch_cpu${cpu} > $ofile
+    done
+elif [[ "$cmd" == "showsketch" ]]; then
+    file="$module_path/sketch"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "writeheatmap" ]]; then
+    ### header and one matrix per traced core (module/heatmap.h)
+    echo "writing HEATMAP.bin ..."
+    cat $module_path/heatmap_matrix > HEATMAP.bin
+elif [[ "$cmd" == "showheatmap" ]]; then
+    file="$module_path/heatmap"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "showfilter" ]]; then
+    file="$module_path/filter_rejected"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "showhist" ]]; then
+    file="$module_path/hist"
+    [[ -f "$file" ]] && cat $file
+    file="$module_path/pebs_batched"
+    [[ -f "$file" ]] && echo "pebs_batched: $(cat $file)"
+    file="$module_path/adapt"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "showphyscache" ]]; then
+    file="$module_path/phys_cache"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "shownuma" ]]; then
+    file="$module_path/numa"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "writenuma" ]]; then
+    ### header and one entry per CPU id (module/numa.h)
+    echo "writing NUMA.bin ..."
+    cat $module_path/numa_matrix > NUMA.bin
+elif [[ "$cmd" == "showhash" ]]; then
+    file="$module_path/hash_table"
+    [[ -f "$file" ]] && cat $file
+elif [[ "$cmd" == "stream" ]]; then
+    if [[ "$(cat $module_path/buffers_stream)" -ne 1 ]]; then
+        echo "error: buffers not set up for streaming (set --stream)"
+        exit 1
+    fi
+    ### one reader per core; readers block until data is available
+    ### and finish after tracing is stopped
+    for cpu in $(traced_cpus)
+    do
+        ofile="$(printf "CPU%03d.bin" "$cpu")"
+        echo "streaming $ofile ..."
+        cat ${device_path}_cpu${cpu} > $ofile &
+    done
+    [[ -f $module_path/buffers_schema ]] && cat $module_path/buffers_schema > schema.txt
+    [[ -f $module_path/buffers_tags ]] && cat $module_path/buffers_tags > tags.txt
+    wait
+elif [[ "$cmd" == "stop" ]]; then
+    echo 0 > $module_path/buffers_enabled
+    [[ -f $module_path/sketch_enabled ]] && echo 0 > $module_path/sketch_enabled
+    [[ -f $module_path/heatmap_enabled ]] && echo 0 > $module_path/heatmap_enabled
 else
     echo "unknow command: $cmd"
     exit 1
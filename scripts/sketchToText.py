@@ -0,0 +1,37 @@
+#!/usr/bin/python3
+
+import argparse
+import struct
+
+parser = argparse.ArgumentParser(description='Print binary history of sketches of a core (device _sketch_cpu<X>): one line per epoch')
+parser.add_argument('input', metavar='FILE', type=str, nargs='+',
+                    help='history of a core, e.g., SKETCH000.bin written by "module.sh writesketch"')
+parser.add_argument('--top', metavar='N', type=int, default=8, help='print at most N hot pages per epoch')
+parser.add_argument('--csv', action='store_true', help='print comma separated values without hot pages')
+args = parser.parse_args()
+
+### layout of struct mat_sketch_epoch (module/sketch.h)
+TOPK = 8
+PAGE_SHIFT = 12
+EPOCH = struct.Struct('<6Q' + 'Q' * (2 * TOPK))
+
+if args.csv:
+    print('file,seq,start_ns,ms,samples,lines,pages')
+for path in args.input:
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) % EPOCH.size:
+        raise SystemExit('error: size of {} is not a multiple of {} bytes'.format(path, EPOCH.size))
+    if not args.csv and len(args.input) > 1:
+        print(path + ':')
+    for off in range(0, len(data), EPOCH.size):
+        v = EPOCH.unpack_from(data, off)
+        seq, start, end, samples, lines, pages = v[:6]
+        top = [(p, c) for p, c in zip(v[6:6+TOPK], v[6+TOPK:]) if c][:args.top]
+        ms = (end - start) / 1e6
+        if args.csv:
+            print('{},{},{},{:.1f},{},{},{}'.format(path, seq, start, ms, samples, lines, pages))
+            continue
+        print('epoch {:6d} ({:7.1f} ms): samples={} lines={} ({} KiB) pages={} ({} KiB) top={}'.format(
+            seq, ms, samples, lines, lines * 64 // 1024, pages, pages * 4, ' '.join(
+                '0x{:x}:{}'.format(p << PAGE_SHIFT, c) for p, c in top)))
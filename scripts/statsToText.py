@@ -0,0 +1,63 @@
+#!/usr/bin/python3
+
+import argparse
+import struct
+import time
+
+parser = argparse.ArgumentParser(description='Print binary statistics of kernel module (attribute "stats"): one line per core')
+parser.add_argument('input', metavar='FILE', type=str, nargs='?',
+                    default='/sys/devices/virtual/memory_address_tracer/memory_address_tracer/stats',
+                    help='path to stats attribute or a copy of it')
+parser.add_argument('--all', action='store_true', help='print cores that are not traced')
+parser.add_argument('--ranges', action='store_true', help='print range counters of every core')
+parser.add_argument('--interval', metavar='SECONDS', type=float, default=0,
+                    help='read statistics repeatedly and print samples per second')
+args = parser.parse_args()
+
+### layout of struct mat_stats_header and struct mat_stats_cpu (module/stats.h)
+MAGIC = 0x544154535f54414d
+HEADER = struct.Struct('<QIIIIII')
+FLAG_TRACED = 1 << 2
+
+def read_stats(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, header_bytes, cpu_bytes, cpus, buf_num, ranges = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != 1:
+        raise SystemExit('error: unknown format of ' + path)
+    entry = struct.Struct('<iIII' + 'Q' * (2 * buf_num + 8 + ranges))
+    stats = []
+    for i in range(cpus):
+        v = entry.unpack_from(data, header_bytes + i * cpu_bytes)
+        cpu, flags, buf_idx, ranges_num = v[:4]
+        v = v[4:]
+        s = {'cpu': cpu, 'flags': flags, 'buf_idx': buf_idx,
+             'capacity': sum(v[0:buf_num]), 'size': sum(v[buf_num:2*buf_num])}
+        v = v[2*buf_num:]
+        for k, name in enumerate(['accepted', 'dropped', 'zero', 'rejected_task', 'rejected_addr',
+                                  'rejected_mem', 'hash_samples', 'hash_evicted']):
+            s[name] = v[k]
+        s['ranges'] = v[8:8+ranges_num]
+        stats.append(s)
+    return stats
+
+def show(stats, prev, seconds):
+    for s in stats:
+        if not s['flags'] or (not args.all and not s['flags'] & FLAG_TRACED):
+            continue
+        line = 'CPU {:3d}: capacity={} size={} accepted={} dropped={} zero={} rejected={}/{}/{} hash={} evicted={}'.format(
+            s['cpu'], s['capacity'], s['size'], s['accepted'], s['dropped'], s['zero'],
+            s['rejected_task'], s['rejected_addr'], s['rejected_mem'], s['hash_samples'], s['hash_evicted'])
+        if prev:
+            line += ' accepted/s={:.0f}'.format((s['accepted'] - prev[s['cpu']]['accepted']) / seconds)
+        print(line)
+        if args.ranges and s['ranges']:
+            print('         ranges=' + ' '.join(str(r) for r in s['ranges']))
+
+stats = read_stats(args.input)
+show(stats, None, 0)
+while args.interval > 0:
+    time.sleep(args.interval)
+    prev, stats = stats, read_stats(args.input)
+    print()
+    show(stats, prev, args.interval)
@@ -0,0 +1,151 @@
+/*
+ * Decode per-core buffers written with encoding "varint" (delta + varint)
+ * to raw addresses: 8 bytes per address, same format as encoding "raw".
+ *
+ * build: gcc -O3 -o varintToBinary varintToBinary.c
+ * usage: varintToBinary [-x] FILE > OUTPUT
+ *     -x  print addresses as hexadecimal string (0x... + \n)
+ *
+ * format (see MAT_BUF_ENCODING_VARINT in include/linux/mat.h):
+ * stream of LEB128 varints; 0 is padding, 1 is followed by an absolute
+ * address (keyframe), V >= 2 is a zig-zag encoded delta (V - 2) to the
+ * previous address.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define OUT_NUM (1 << 16)
+
+static uint64_t out[OUT_NUM];
+
+static void flush(size_t num, int hex)
+{
+    size_t i;
+    if(hex)
+    {
+        for(i=0; i<num; i++)
+        {
+            printf("0x%016llx\n", (unsigned long long)out[i]);
+        }
+    }
+    else if(fwrite(out, sizeof(uint64_t), num, stdout) != num)
+    {
+        perror("fwrite");
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    const uint8_t* data;
+    struct stat st;
+    uint64_t addr = 0;
+    size_t num = 0;
+    int hex = 0;
+    int fd;
+
+    if(argc == 3 && strcmp(argv[1], "-x") == 0)
+    {
+        hex = 1;
+    }
+    else if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s [-x] FILE\n", argv[0]);
+        return 1;
+    }
+
+    fd = open(argv[argc-1], O_RDONLY);
+    if(fd < 0 || fstat(fd, &st) < 0)
+    {
+        perror(argv[argc-1]);
+        return 1;
+    }
+    if(st.st_size == 0)
+    {
+        return 0;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    madvise((void*)data, st.st_size, MADV_SEQUENTIAL);
+
+    p   = data;
+    end = data + st.st_size;
+    while(p < end)
+    {
+        uint64_t v;
+        /* fast path: most deltas fit into a single byte */
+        if(*p < 0x80)
+        {
+            v = *p++;
+        }
+        else
+        {
+            unsigned shift = 0;
+            v = 0;
+            while(p < end && *p >= 0x80 && shift < 64)
+            {
+                v |= (uint64_t)(*p++ & 0x7f) << shift;
+                shift += 7;
+            }
+            if(p >= end || shift >= 64)
+            {
+                fprintf(stderr, "truncated varint at offset %td\n", p - data);
+                break;
+            }
+            v |= (uint64_t)(*p++) << shift;
+        }
+
+        if(v == 0)
+        {
+            /* padding */
+            continue;
+        }
+        if(v == 1)
+        {
+            /* keyframe: absolute address follows */
+            unsigned shift = 0;
+            v = 0;
+            while(p < end && *p >= 0x80 && shift < 64)
+            {
+                v |= (uint64_t)(*p++ & 0x7f) << shift;
+                shift += 7;
+            }
+            if(p >= end || shift >= 64)
+            {
+                fprintf(stderr, "truncated keyframe at offset %td\n", p - data);
+                break;
+            }
+            v |= (uint64_t)(*p++) << shift;
+            addr = v;
+        }
+        else
+        {
+            v -= 2;
+            addr += (v >> 1) ^ -(v & 1);
+        }
+
+        out[num++] = addr;
+        if(num == OUT_NUM)
+        {
+            flush(num, hex);
+            num = 0;
+        }
+    }
+    flush(num, hex);
+
+    munmap((void*)data, st.st_size);
+    close(fd);
+    return 0;
+}